@@ -0,0 +1,428 @@
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QScopedArrayPointer>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <iostream>
+
+#include "attacktable.h"
+#include "movegenerator.h"
+#include "position.h"
+
+/*
+ * Counts the leaf nodes of the legal move tree to a fixed depth.  The
+ * counts are compared against published values so this doubles as the
+ * regression suite and the benchmark for the move generator.
+ */
+
+struct Reference {
+    const char *fen;
+    int depth;
+    quint64 nodes;
+};
+
+static const Reference s_references[] = {
+    { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, Q_UINT64_C(4865609) },
+    { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, Q_UINT64_C(4085603) },
+    { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, Q_UINT64_C(11030083) },
+    { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, Q_UINT64_C(15833292) },
+    { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, Q_UINT64_C(2103487) },
+    { "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, Q_UINT64_C(3894594) },
+    { "bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w HFhf - 2 9", 4, Q_UINT64_C(326672) },
+    { "2nnrbkr/p1qppppp/8/1ppb4/6PP/3PP3/PPP2P2/BQNNRBKR w HEhe - 1 9", 4, Q_UINT64_C(667366) },
+    { "b1q1rrkb/pppppppp/3nn3/8/P7/1PPP4/4PPPP/BQNNRKRB w GE - 1 9", 4, Q_UINT64_C(273318) },
+    { "qbbnnrkr/2pp2pp/p7/1p2pp2/8/P3PP2/1PPP1KPP/QBBNNR1R w hf - 0 9", 4, Q_UINT64_C(382958) },
+    { "1nbbnrkr/p1p1ppp1/3p4/1p3P1p/3Pq2P/8/PPP1P1P1/QNBBNRKR w HFhf - 0 9", 4, Q_UINT64_C(1171749) },
+    { "qnbnr1kr/ppp1b1pp/4p3/3p1p2/8/2NPP3/PPP1BPPP/QNB1R1KR w HEhe - 1 9", 4, Q_UINT64_C(824055) },
+    { "q1bnrkr1/ppppp2p/2n2p2/4b1p1/2NP4/8/PPP1PPPP/QNB1RRKB w ge - 1 9", 4, Q_UINT64_C(732757) },
+    { "qbn1brkr/ppp1p1p1/2n4p/3p1p2/P7/6PP/QPPPPP2/1BNNBRKR w HFhf - 0 9", 4, Q_UINT64_C(465806) }
+};
+
+/*
+ * The hash is shared by every thread without a lock.  The node count and
+ * depth are packed into one word and the key is stored xor'ed with it, so
+ * an entry torn by two threads writing at once simply fails to match.
+ */
+struct HashEntry {
+    std::atomic<quint64> check;
+    std::atomic<quint64> data;
+};
+
+struct PerftTask {
+    Position position;
+    int depth;
+    int root;
+};
+
+struct ThreadStats {
+    quint64 nodes;
+    int tasks;
+    qint64 elapsed;
+};
+
+class Perft {
+public:
+    Perft(int hashMegabytes, bool isBulk, int threads);
+
+    quint64 run(const Position &position, int depth);
+    void divide(const Position &position, int depth);
+
+    quint64 search(Position &position, int depth);
+
+private:
+    quint64 runParallel(const Position &position, int depth, QVector<quint64> *rootNodes);
+
+    QScopedArrayPointer<HashEntry> m_hash;
+    quint64 m_hashMask;
+    bool m_isBulk;
+    int m_threads;
+    QVector<ThreadStats> m_threadStats;
+};
+
+/*
+ * Takes the next subtree off the shared list until none are left, so a
+ * thread that drew small subtrees keeps going while another is still busy
+ * with a large one.
+ */
+class PerftWorker : public QThread {
+public:
+    PerftWorker(Perft *perft, const QVector<PerftTask> *tasks, QAtomicInt *next, int rootCount);
+
+    const QVector<quint64> &rootNodes() const { return m_rootNodes; }
+    ThreadStats stats() const { return m_stats; }
+
+protected:
+    void run();
+
+private:
+    Perft *m_perft;
+    const QVector<PerftTask> *m_tasks;
+    QAtomicInt *m_next;
+    QVector<quint64> m_rootNodes;
+    ThreadStats m_stats;
+};
+
+static QString squareToString(int square)
+{
+    return QString("%1%2").arg(QChar('a' + square % 8)).arg(QChar('1' + square / 8));
+}
+
+static QString moveToString(PackedMove move)
+{
+    QString string = squareToString(move.from()) + squareToString(move.to());
+    switch (move.promotion()) {
+    case Chess::Queen: return string + 'q';
+    case Chess::Rook: return string + 'r';
+    case Chess::Bishop: return string + 'b';
+    case Chess::Knight: return string + 'n';
+    default: return string;
+    }
+}
+
+PerftWorker::PerftWorker(Perft *perft, const QVector<PerftTask> *tasks, QAtomicInt *next, int rootCount)
+    : m_perft(perft),
+      m_tasks(tasks),
+      m_next(next),
+      m_rootNodes(rootCount, 0)
+{
+    m_stats.nodes = 0;
+    m_stats.tasks = 0;
+    m_stats.elapsed = 0;
+}
+
+void PerftWorker::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    int index;
+    while ((index = m_next->fetchAndAddRelaxed(1)) < m_tasks->count()) {
+        const PerftTask &task = m_tasks->at(index);
+        Position position(task.position);
+        quint64 nodes = m_perft->search(position, task.depth);
+        m_rootNodes[task.root] += nodes;
+        m_stats.nodes += nodes;
+        ++m_stats.tasks;
+    }
+    m_stats.elapsed = timer.elapsed();
+}
+
+/* lists the positions 'plies' below 'position' along with the root move each came from */
+static void collectTasks(const Position &position, int plies, int depth, int root, QVector<PerftTask> *tasks)
+{
+    if (plies == 0) {
+        PerftTask task = { position, depth, root };
+        tasks->append(task);
+        return;
+    }
+
+    MoveBuffer moves;
+    MoveGenerator::generateLegalMoves(position, moves);
+    for (int i = 0; i < moves.count(); ++i) {
+        Position child(position);
+        child.makeMove(moves.at(i));
+        collectTasks(child, plies - 1, depth - 1, root < 0 ? i : root, tasks);
+    }
+}
+
+Perft::Perft(int hashMegabytes, bool isBulk, int threads)
+    : m_hashMask(0),
+      m_isBulk(isBulk),
+      m_threads(qMax(1, threads))
+{
+    if (hashMegabytes <= 0)
+        return;
+
+    //round down to a power of two so the key can be masked into an index
+    quint64 entries = quint64(hashMegabytes) * 1024 * 1024 / sizeof(HashEntry);
+    quint64 size = 1;
+    while (size * 2 <= entries)
+        size *= 2;
+    m_hash.reset(new HashEntry[size]());
+    m_hashMask = size - 1;
+}
+
+quint64 Perft::run(const Position &position, int depth)
+{
+    if (m_threads > 1 && depth > 1)
+        return runParallel(position, depth, 0);
+
+    Position copy(position);
+    return depth > 0 ? search(copy, depth) : 1;
+}
+
+quint64 Perft::runParallel(const Position &position, int depth, QVector<quint64> *rootNodes)
+{
+    //two plies down gives a few hundred subtrees, enough to keep many threads evenly loaded
+    QVector<PerftTask> tasks;
+    collectTasks(position, depth > 3 ? 2 : 1, depth, -1, &tasks);
+
+    MoveBuffer moves;
+    MoveGenerator::generateLegalMoves(position, moves);
+
+    QAtomicInt next(0);
+    QVector<PerftWorker*> workers;
+    for (int i = 0; i < m_threads; ++i) {
+        workers.append(new PerftWorker(this, &tasks, &next, moves.count()));
+        workers.last()->start();
+    }
+
+    quint64 total = 0;
+    m_threadStats.clear();
+    foreach (PerftWorker *worker, workers) {
+        worker->wait();
+        for (int i = 0; i < moves.count(); ++i) {
+            total += worker->rootNodes().at(i);
+            if (rootNodes)
+                (*rootNodes)[i] += worker->rootNodes().at(i);
+        }
+        m_threadStats.append(worker->stats());
+        delete worker;
+    }
+    return total;
+}
+
+void Perft::divide(const Position &position, int depth)
+{
+    MoveBuffer moves;
+    MoveGenerator::generateLegalMoves(position, moves);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<quint64> rootNodes(moves.count(), 0);
+    if (m_threads > 1 && depth > 1) {
+        runParallel(position, depth, &rootNodes);
+    } else {
+        for (int i = 0; i < moves.count(); ++i) {
+            Position child(position);
+            child.makeMove(moves.at(i));
+            rootNodes[i] = run(child, depth - 1);
+        }
+    }
+
+    quint64 total = 0;
+    for (int i = 0; i < moves.count(); ++i) {
+        total += rootNodes.at(i);
+        std::cout << moveToString(moves.at(i)).toLatin1().constData() << ": " << rootNodes.at(i) << "\n";
+    }
+
+    qint64 elapsed = qMax(qint64(1), timer.elapsed());
+    std::cout << "\nMoves: " << moves.count()
+              << "\nNodes: " << total
+              << "\nTime: " << elapsed << " ms"
+              << "\nNodes/sec: " << total * 1000 / elapsed
+              << "\n";
+
+    if (m_threads > 1 && depth > 1) {
+        std::cout << "\n";
+        for (int i = 0; i < m_threadStats.count(); ++i) {
+            const ThreadStats &stats = m_threadStats.at(i);
+            std::cout << "Thread " << i << ": " << stats.nodes << " nodes, " << stats.tasks << " subtrees, "
+                      << stats.nodes * 1000 / qMax(qint64(1), stats.elapsed) << " nodes/sec\n";
+        }
+    }
+}
+
+quint64 Perft::search(Position &position, int depth)
+{
+    HashEntry *entry = 0;
+    quint64 hashKey = 0;
+    if (m_hash && depth > 1) {
+        hashKey = position.key();
+        entry = m_hash.data() + (hashKey & m_hashMask); //operator[] takes an int
+        quint64 data = entry->data.load(std::memory_order_relaxed);
+        quint64 check = entry->check.load(std::memory_order_relaxed);
+        if ((check ^ data) == hashKey && int(data & 0xff) == depth)
+            return data >> 8;
+    }
+
+    MoveBuffer moves;
+    MoveGenerator::generateLegalMoves(position, moves);
+
+    //every legal move is a leaf so there is no need to make them
+    quint64 nodes = 0;
+    if (depth == 1 && m_isBulk) {
+        nodes = moves.count();
+    } else {
+        for (int i = 0; i < moves.count(); ++i) {
+            PackedMove move = moves.at(i);
+            Position::SavedState state;
+            position.makeMove(move, state);
+            nodes += depth > 1 ? search(position, depth - 1) : 1;
+            position.unmakeMove(move, state);
+        }
+    }
+
+    if (entry) {
+        quint64 data = nodes << 8 | quint64(depth);
+        entry->check.store(hashKey ^ data, std::memory_order_relaxed);
+        entry->data.store(data, std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+static int runSuite(Perft *perft, int depth960, const QString &fileName)
+{
+    int failures = 0;
+    quint64 totalNodes = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    for (uint i = 0; i < sizeof(s_references) / sizeof(Reference); ++i) {
+        const Reference &reference = s_references[i];
+        Position position = Position::fromFen(QLatin1String(reference.fen));
+        quint64 nodes = perft->run(position, reference.depth);
+        totalNodes += nodes;
+
+        if (nodes == reference.nodes) {
+            std::cout << "ok    " << reference.fen << " depth " << reference.depth << ": " << nodes << "\n";
+        } else {
+            ++failures;
+            std::cout << "FAIL  " << reference.fen << " depth " << reference.depth << ": " << nodes
+                      << " expected " << reference.nodes << "\n";
+        }
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        std::cout << "FAIL  cannot open " << fileName.toLocal8Bit().constData() << "\n";
+        return failures + 1;
+    }
+
+    //published Chess960 counts are checked above, here every start array has bulk counting checked against making each leaf
+    Perft slow(0, false, 1);
+    int positions = 0;
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        QString fen = stream.readLine().trimmed();
+        if (fen.isEmpty())
+            continue;
+
+        bool ok;
+        Position position = Position::fromFen(fen, &ok);
+        quint64 nodes = ok ? perft->run(position, depth960) : 0;
+        totalNodes += nodes;
+        ++positions;
+
+        if (!ok || nodes != slow.run(position, depth960)) {
+            ++failures;
+            std::cout << "FAIL  " << fen.toLatin1().constData() << "\n";
+        }
+    }
+    std::cout << "ok    " << positions << " Chess960 starts to depth " << depth960 << "\n";
+
+    qint64 elapsed = qMax(qint64(1), timer.elapsed());
+    std::cout << "\nFailures: " << failures
+              << "\nNodes: " << totalNodes
+              << "\nTime: " << elapsed << " ms"
+              << "\nNodes/sec: " << totalNodes * 1000 / elapsed
+              << "\n";
+    return failures;
+}
+
+static void usage()
+{
+    std::cout << "usage: perft [--hash <MB>] [--threads <n>] [--no-bulk] <fen> <depth>\n"
+              << "       perft [--hash <MB>] [--threads <n>] [--no-bulk] --suite [<960 depth>] [<960 fen file>]\n"
+              << "       a thread count of 0 uses every core\n";
+}
+
+int main(int argc, char *argv[])
+{
+    AttackTable::initialize();
+
+    QStringList arguments;
+    for (int i = 1; i < argc; ++i)
+        arguments << QString::fromLocal8Bit(argv[i]);
+
+    int hashMegabytes = 0;
+    int threads = 1;
+    bool isBulk = true;
+    bool isSuite = false;
+    QStringList positional;
+    for (int i = 0; i < arguments.count(); ++i) {
+        if (arguments.at(i) == QLatin1String("--hash") && i + 1 < arguments.count())
+            hashMegabytes = arguments.at(++i).toInt();
+        else if (arguments.at(i) == QLatin1String("--threads") && i + 1 < arguments.count())
+            threads = arguments.at(++i).toInt();
+        else if (arguments.at(i) == QLatin1String("--no-bulk"))
+            isBulk = false;
+        else if (arguments.at(i) == QLatin1String("--suite"))
+            isSuite = true;
+        else
+            positional << arguments.at(i);
+    }
+
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    Perft perft(hashMegabytes, isBulk, threads);
+
+    if (isSuite) {
+        int depth = positional.count() > 0 ? positional.at(0).toInt() : 3;
+        QString fileName = positional.count() > 1 ? positional.at(1) : QLatin1String(PERFT_960FEN);
+        return runSuite(&perft, depth, fileName) ? 1 : 0;
+    }
+
+    if (positional.count() != 2) {
+        usage();
+        return 2;
+    }
+
+    bool ok;
+    Position position = Position::fromFen(positional.at(0), &ok);
+    int depth = positional.at(1).toInt();
+    if (!ok || depth < 1) {
+        usage();
+        return 2;
+    }
+
+    perft.divide(position, depth);
+    return 0;
+}
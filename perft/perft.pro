@@ -0,0 +1,22 @@
+include($$PWD/../queensmate.pri)
+
+QT -= gui
+
+TEMPLATE = app
+TARGET = perft
+CONFIG += console
+
+INCLUDEPATH += \
+    $$TOPLEVELDIR/src
+
+DEFINES += PERFT_960FEN=\\\"$$TOPLEVELDIR/src/resources/960fen.txt\\\"
+
+SOURCES += \
+    main.cpp \
+    $$TOPLEVELDIR/src/attacktable.cpp \
+    $$TOPLEVELDIR/src/bitboard.cpp \
+    $$TOPLEVELDIR/src/fen.cpp \
+    $$TOPLEVELDIR/src/movegenerator.cpp \
+    $$TOPLEVELDIR/src/position.cpp \
+    $$TOPLEVELDIR/src/square.cpp \
+    $$TOPLEVELDIR/src/zobrist.cpp
@@ -1,5 +1,7 @@
 QT += core
 
+CONFIG += c++14
+
 TOPLEVELDIR = $$PWD
 
 PROJECT_SOURCE_DIR = $$TOPLEVELDIR/..
@@ -3,4 +3,5 @@ CONFIG += ordered
 
 SUBDIRS += \
     src \
-    960fen
+    960fen \
+    perft
@@ -0,0 +1,166 @@
+#include "attacktable.h"
+
+/* Found by trial with sparse random candidates, see initialize() for the layout */
+static const quint64 s_rookMagics[64] = {
+    Q_UINT64_C(0x1080004008801020), Q_UINT64_C(0x0840092002c03000), Q_UINT64_C(0x1900200010400900), Q_UINT64_C(0x0880100008000480),
+    Q_UINT64_C(0x4200100420080200), Q_UINT64_C(0x8100020100080400), Q_UINT64_C(0x0200040110886200), Q_UINT64_C(0x0200008040220411),
+    Q_UINT64_C(0x0404800084400220), Q_UINT64_C(0x0000401000402000), Q_UINT64_C(0x0086001081220440), Q_UINT64_C(0x0408800800100280),
+    Q_UINT64_C(0x000a001201040820), Q_UINT64_C(0x8848800200840080), Q_UINT64_C(0x4001000100040200), Q_UINT64_C(0x0442000102105084),
+    Q_UINT64_C(0x9080010020804100), Q_UINT64_C(0x0040404000201009), Q_UINT64_C(0x0000808010002009), Q_UINT64_C(0x2200090021d00100),
+    Q_UINT64_C(0x0008008008040080), Q_UINT64_C(0x0004004002010040), Q_UINT64_C(0x0011040008015042), Q_UINT64_C(0x00000a0001768104),
+    Q_UINT64_C(0x0000800080204009), Q_UINT64_C(0x2010004140002001), Q_UINT64_C(0x9800200280100080), Q_UINT64_C(0x1000100080080080),
+    Q_UINT64_C(0x0442000a00049020), Q_UINT64_C(0x2100040080020080), Q_UINT64_C(0x0800120400900148), Q_UINT64_C(0x0010040a00128541),
+    Q_UINT64_C(0x2800804000800030), Q_UINT64_C(0x1010002000400041), Q_UINT64_C(0x4000200011004100), Q_UINT64_C(0x0610008410800800),
+    Q_UINT64_C(0x0400802402800800), Q_UINT64_C(0xc100020080800400), Q_UINT64_C(0x0002000802000401), Q_UINT64_C(0x0182085882000401),
+    Q_UINT64_C(0x0220204000808000), Q_UINT64_C(0x2860100040024022), Q_UINT64_C(0x0001002004110040), Q_UINT64_C(0x99101042000a0020),
+    Q_UINT64_C(0x0004080004008080), Q_UINT64_C(0x0010040002008080), Q_UINT64_C(0x2012004881020004), Q_UINT64_C(0x8300842444820011),
+    Q_UINT64_C(0x0088403882010200), Q_UINT64_C(0x0820400080210100), Q_UINT64_C(0x0110910040a00300), Q_UINT64_C(0x0801100280080480),
+    Q_UINT64_C(0x0242009008200600), Q_UINT64_C(0x1002000489500200), Q_UINT64_C(0x0040800200010080), Q_UINT64_C(0x0091800041000080),
+    Q_UINT64_C(0x0000209300488001), Q_UINT64_C(0x04c1002414824001), Q_UINT64_C(0x020020000b001041), Q_UINT64_C(0x7000100004200901),
+    Q_UINT64_C(0x8002002004100802), Q_UINT64_C(0x30010002084c0007), Q_UINT64_C(0x0888221800813004), Q_UINT64_C(0x4000002840840112)
+};
+
+static const quint64 s_bishopMagics[64] = {
+    Q_UINT64_C(0xa010041108003100), Q_UINT64_C(0x006082020a002900), Q_UINT64_C(0x6810010619200000), Q_UINT64_C(0x08281a0520000408),
+    Q_UINT64_C(0x0001104001000400), Q_UINT64_C(0x0018901008048400), Q_UINT64_C(0x00040a0210245280), Q_UINT64_C(0x000200210808a402),
+    Q_UINT64_C(0x9140048410821200), Q_UINT64_C(0x0800091010820041), Q_UINT64_C(0x20504804832202c0), Q_UINT64_C(0x0100091401081000),
+    Q_UINT64_C(0x8021011140000012), Q_UINT64_C(0x0810020804450400), Q_UINT64_C(0x208b0542109008a2), Q_UINT64_C(0x0080084a08040204),
+    Q_UINT64_C(0x0040e2a80811244c), Q_UINT64_C(0x2505022008008108), Q_UINT64_C(0x0430220100420040), Q_UINT64_C(0x010a040420220040),
+    Q_UINT64_C(0x1105000290400000), Q_UINT64_C(0x0093001200822120), Q_UINT64_C(0x4000a62048043004), Q_UINT64_C(0x280120048a015004),
+    Q_UINT64_C(0x006090002a020814), Q_UINT64_C(0x44042000240800d0), Q_UINT64_C(0x01102800040a4400), Q_UINT64_C(0x1004080080220040),
+    Q_UINT64_C(0x0001001011004024), Q_UINT64_C(0x0010044000805040), Q_UINT64_C(0x0914041200820100), Q_UINT64_C(0x0004821012821480),
+    Q_UINT64_C(0x0024040500c05021), Q_UINT64_C(0x0088611002080200), Q_UINT64_C(0x0116080a00040020), Q_UINT64_C(0x4000020080080080),
+    Q_UINT64_C(0x2450450140840040), Q_UINT64_C(0x0000880201484100), Q_UINT64_C(0x0222020404020092), Q_UINT64_C(0x8081110600002e00),
+    Q_UINT64_C(0x2842101105000801), Q_UINT64_C(0x1100809008001025), Q_UINT64_C(0x00020202221c0400), Q_UINT64_C(0x0422014022009020),
+    Q_UINT64_C(0x0210046102100c00), Q_UINT64_C(0xc004008082029102), Q_UINT64_C(0x00aa461801101200), Q_UINT64_C(0x0404080080201108),
+    Q_UINT64_C(0x020542108c205002), Q_UINT64_C(0x0410544804100100), Q_UINT64_C(0x0040910841100000), Q_UINT64_C(0x0400200042021100),
+    Q_UINT64_C(0x00004204850400c0), Q_UINT64_C(0x0200100410a42102), Q_UINT64_C(0x1040020801210102), Q_UINT64_C(0x0805040410420000),
+    Q_UINT64_C(0x2884804130100200), Q_UINT64_C(0x800c262201242000), Q_UINT64_C(0x1058000194108800), Q_UINT64_C(0x0014221054420204),
+    Q_UINT64_C(0x0104000012a02200), Q_UINT64_C(0x0200881003300100), Q_UINT64_C(0x0140400202840100), Q_UINT64_C(0x0402020801010201)
+};
+
+static const int s_rookDirections[4][2] = { { 0, 1 }, { 1, 0 }, { 0, -1 }, { -1, 0 } };
+static const int s_bishopDirections[4][2] = { { 1, 1 }, { 1, -1 }, { -1, -1 }, { -1, 1 } };
+
+static BitBoard s_rookAttacks[0x19000];
+static BitBoard s_bishopAttacks[0x1480];
+
+constexpr LeaperTable AttackTable::s_leapers;
+
+AttackTable::SliderEntry AttackTable::s_rookEntries[64];
+AttackTable::SliderEntry AttackTable::s_bishopEntries[64];
+BitBoard AttackTable::s_between[64][64];
+BitBoard AttackTable::s_lines[64][64];
+bool AttackTable::s_isPextEnabled = false;
+
+static quint64 slidingAttacks(int square, quint64 occupied, const int directions[4][2])
+{
+    quint64 attacks = 0;
+    for (int i = 0; i < 4; ++i) {
+        int f = square % 8 + directions[i][0];
+        int r = square / 8 + directions[i][1];
+        for (; f >= 0 && f < 8 && r >= 0 && r < 8; f += directions[i][0], r += directions[i][1]) {
+            quint64 bit = quint64(1) << (r * 8 + f);
+            attacks |= bit;
+            if (occupied & bit)
+                break;
+        }
+    }
+    return attacks;
+}
+
+static quint64 relevantOccupancy(int square, const int directions[4][2])
+{
+    //the last square of each ray never blocks anything so it is left out
+    quint64 mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        int f = square % 8 + directions[i][0];
+        int r = square / 8 + directions[i][1];
+        for (; f >= 0 && f < 8 && r >= 0 && r < 8; f += directions[i][0], r += directions[i][1]) {
+            int nextFile = f + directions[i][0];
+            int nextRank = r + directions[i][1];
+            if (nextFile < 0 || nextFile > 7 || nextRank < 0 || nextRank > 7)
+                break;
+            mask |= quint64(1) << (r * 8 + f);
+        }
+    }
+    return mask;
+}
+
+static bool processorHasPext()
+{
+#if defined(ATTACKTABLE_PEXT) && defined(Q_CC_MSVC)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 8);
+#elif defined(ATTACKTABLE_PEXT)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+static void initializeAttackTables()
+{
+    AttackTable::initialize();
+}
+Q_CONSTRUCTOR_FUNCTION(initializeAttackTables)
+
+void AttackTable::initialize()
+{
+    static bool initialized = false;
+    if (initialized)
+        return;
+    initialized = true;
+
+    s_isPextEnabled = processorHasPext();
+
+    for (int piece = 0; piece < 2; ++piece) {
+        SliderEntry *entries = piece == 0 ? s_rookEntries : s_bishopEntries;
+        const quint64 *magics = piece == 0 ? s_rookMagics : s_bishopMagics;
+        const int (*directions)[2] = piece == 0 ? s_rookDirections : s_bishopDirections;
+        BitBoard *attacks = piece == 0 ? s_rookAttacks : s_bishopAttacks;
+
+        for (int square = 0; square < 64; ++square) {
+            SliderEntry &entry = entries[square];
+            entry.mask = relevantOccupancy(square, directions);
+            entry.magic = magics[square];
+            entry.shift = 64 - BitBoard::populationCount(entry.mask);
+            entry.attacks = attacks;
+
+            //walk every subset of the mask with the carry rippler trick
+            quint64 occupied = 0;
+            do {
+                BitBoard rays(slidingAttacks(square, occupied, directions));
+                int i = index(entry, occupied);
+                Q_ASSERT(entry.attacks[i].isClear() || entry.attacks[i] == rays);
+                entry.attacks[i] = rays;
+                occupied = (occupied - entry.mask) & entry.mask;
+            } while (occupied);
+
+            attacks += quint64(1) << (64 - entry.shift);
+        }
+
+        Q_ASSERT(attacks == (piece == 0 ? s_rookAttacks + 0x19000 : s_bishopAttacks + 0x1480));
+    }
+
+    for (int from = 0; from < 64; ++from) {
+        for (int to = 0; to < 64; ++to) {
+            if (from == to)
+                continue;
+
+            BitBoard ends = BitBoard::fromBit(from) | BitBoard::fromBit(to);
+            if (rook(from, BitBoard()).testBit(to)) {
+                s_between[from][to] = rook(from, ends) & rook(to, ends);
+                s_lines[from][to] = (rook(from, BitBoard()) & rook(to, BitBoard())) | ends;
+            } else if (bishop(from, BitBoard()).testBit(to)) {
+                s_between[from][to] = bishop(from, ends) & bishop(to, ends);
+                s_lines[from][to] = (bishop(from, BitBoard()) & bishop(to, BitBoard())) | ends;
+            }
+        }
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef ATTACKTABLE_H
+#define ATTACKTABLE_H
+
+#include <QtGlobal>
+
+#include "chess.h"
+#include "bitboard.h"
+
+#if defined(Q_PROCESSOR_X86_64) && (defined(Q_CC_GNU) || defined(Q_CC_MSVC))
+#define ATTACKTABLE_PEXT
+#if defined(Q_CC_MSVC)
+#include <immintrin.h>
+#endif
+#endif
+
+/*
+ * Kings, knights and pawns attack the same squares whatever the occupancy,
+ * so their tables are generated by the compiler.
+ */
+struct LeaperTable {
+    constexpr LeaperTable();
+
+    BitBoard king[64];
+    BitBoard knight[64];
+    BitBoard pawnAttacks[2][64];
+    BitBoard pawnPushes[2][64];
+    BitBoard pawnDoublePushes[2][64];
+
+private:
+    static constexpr quint64 bitAt(int file, int rank)
+    { return file >= 0 && file < 8 && rank >= 0 && rank < 8 ? quint64(1) << (rank * 8 + file) : 0; }
+};
+
+constexpr LeaperTable::LeaperTable()
+    : king(), knight(), pawnAttacks(), pawnPushes(), pawnDoublePushes()
+{
+    const int kingSteps[8][2] = { { 0, 1 }, { 1, 1 }, { 1, 0 }, { 1, -1 }, { 0, -1 }, { -1, -1 }, { -1, 0 }, { -1, 1 } };
+    const int knightSteps[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+
+    for (int square = 0; square < 64; ++square) {
+        int f = square % 8;
+        int r = square / 8;
+
+        quint64 kingBits = 0;
+        quint64 knightBits = 0;
+        for (int i = 0; i < 8; ++i) {
+            kingBits |= bitAt(f + kingSteps[i][0], r + kingSteps[i][1]);
+            knightBits |= bitAt(f + knightSteps[i][0], r + knightSteps[i][1]);
+        }
+        king[square] = BitBoard(kingBits);
+        knight[square] = BitBoard(knightBits);
+
+        pawnAttacks[Chess::White][square] = BitBoard(bitAt(f - 1, r + 1) | bitAt(f + 1, r + 1));
+        pawnAttacks[Chess::Black][square] = BitBoard(bitAt(f - 1, r - 1) | bitAt(f + 1, r - 1));
+        pawnPushes[Chess::White][square] = BitBoard(bitAt(f, r + 1));
+        pawnPushes[Chess::Black][square] = BitBoard(bitAt(f, r - 1));
+        pawnDoublePushes[Chess::White][square] = BitBoard(r == 1 ? bitAt(f, r + 2) : 0);
+        pawnDoublePushes[Chess::Black][square] = BitBoard(r == 6 ? bitAt(f, r - 2) : 0);
+    }
+}
+
+/*
+ * Precomputed attack sets indexed by square.  The sliding pieces are looked
+ * up with magic multiplication, or with the PEXT instruction when the
+ * processor running us supports BMI2.  Which of the two is used is decided
+ * once when the tables are built at startup.
+ */
+class AttackTable {
+public:
+    static BitBoard rook(int square, BitBoard occupied);
+    static BitBoard bishop(int square, BitBoard occupied);
+    static BitBoard queen(int square, BitBoard occupied) { return rook(square, occupied) | bishop(square, occupied); }
+
+    static constexpr BitBoard king(int square) { return s_leapers.king[square]; }
+    static constexpr BitBoard knight(int square) { return s_leapers.knight[square]; }
+    static constexpr BitBoard pawnAttacks(Chess::Army army, int square) { return s_leapers.pawnAttacks[army][square]; }
+    static constexpr BitBoard pawnPushes(Chess::Army army, int square, BitBoard occupied);
+
+    /* squares strictly between two squares sharing a line, otherwise empty */
+    static BitBoard between(int from, int to) { return s_between[from][to]; }
+    /* the whole edge to edge line through two squares, otherwise empty */
+    static BitBoard line(int from, int to) { return s_lines[from][to]; }
+
+    static bool isPextEnabled() { return s_isPextEnabled; }
+
+    static void initialize();
+
+private:
+    struct SliderEntry {
+        quint64 mask;
+        quint64 magic;
+        BitBoard *attacks;
+        int shift;
+    };
+
+    static int index(const SliderEntry &entry, quint64 occupied);
+    static quint64 pext(quint64 bits, quint64 mask);
+
+    static SliderEntry s_rookEntries[64];
+    static SliderEntry s_bishopEntries[64];
+    static BitBoard s_between[64][64];
+    static BitBoard s_lines[64][64];
+    static bool s_isPextEnabled;
+    static constexpr LeaperTable s_leapers = LeaperTable();
+
+    AttackTable();
+    ~AttackTable();
+};
+
+constexpr BitBoard AttackTable::pawnPushes(Chess::Army army, int square, BitBoard occupied)
+{
+    //the double step is only reachable through an empty single step square
+    BitBoard single = s_leapers.pawnPushes[army][square] & ~occupied;
+    BitBoard between(army == Chess::White ? single.bits() << 8 : single.bits() >> 8);
+    return single | (s_leapers.pawnDoublePushes[army][square] & between & ~occupied);
+}
+
+inline quint64 AttackTable::pext(quint64 bits, quint64 mask)
+{
+#if defined(ATTACKTABLE_PEXT) && defined(Q_CC_MSVC)
+    return _pext_u64(bits, mask);
+#elif defined(ATTACKTABLE_PEXT)
+    /* emitted directly so we do not need to build the whole tree with -mbmi2 */
+    quint64 result;
+    asm ("pextq %2, %1, %0" : "=r" (result) : "r" (bits), "r" (mask));
+    return result;
+#else
+    Q_UNUSED(bits);
+    Q_UNUSED(mask);
+    Q_ASSERT(false);
+    return 0;
+#endif
+}
+
+inline int AttackTable::index(const SliderEntry &entry, quint64 occupied)
+{
+    if (s_isPextEnabled)
+        return int(pext(occupied, entry.mask));
+    return int(((occupied & entry.mask) * entry.magic) >> entry.shift);
+}
+
+inline BitBoard AttackTable::rook(int square, BitBoard occupied)
+{
+    const SliderEntry &entry = s_rookEntries[square];
+    return entry.attacks[index(entry, occupied.bits())];
+}
+
+inline BitBoard AttackTable::bishop(int square, BitBoard occupied)
+{
+    const SliderEntry &entry = s_bishopEntries[square];
+    return entry.attacks[index(entry, occupied.bits())];
+}
+
+#endif
@@ -1,33 +1,117 @@
 #ifndef BITBOARD_H
 #define BITBOARD_H
 
-#include <QBitArray>
+#include <QtGlobal>
 
 #include <QDebug>
 
 #include "square.h"
 
-class BitBoard : public QBitArray {
+#if defined(Q_CC_MSVC)
+#include <intrin.h>
+#endif
+
+/*
+ * A set of squares packed into a single 64 bit word where bit 0 is a1,
+ * bit 7 is h1 and bit 63 is h8. It is a plain value type so copying,
+ * combining and iterating never touches the heap.
+ */
+class BitBoard {
 public:
-    BitBoard();
+    class Iterator {
+    public:
+        constexpr Iterator(quint64 bits) : m_bits(bits) {}
+
+        Square operator*() const { return bitToSquare(lowestBit(m_bits)); }
+        Iterator &operator++() { m_bits &= m_bits - 1; return *this; }
+
+        constexpr bool operator==(const Iterator &other) const { return m_bits == other.m_bits; }
+        constexpr bool operator!=(const Iterator &other) const { return m_bits != other.m_bits; }
+
+    private:
+        quint64 m_bits;
+    };
+    typedef Iterator const_iterator;
+
+    constexpr BitBoard() : m_bits(0) {}
+    constexpr explicit BitBoard(quint64 bits) : m_bits(bits) {}
     BitBoard(const Square &square);
     BitBoard(const SquareList &squareList);
-    BitBoard(const QBitArray &other);
-    ~BitBoard();
 
-    bool isClear() const;
+    constexpr quint64 bits() const { return m_bits; }
+
+    constexpr bool isClear() const { return m_bits == 0; }
+    constexpr bool hasMoreThanOne() const { return (m_bits & (m_bits - 1)) != 0; }
+    int count() const { return populationCount(m_bits); }
+
+    constexpr bool testBit(int bit) const { return (m_bits >> bit) & 1; }
+    constexpr void setBit(int bit, bool value = true)
+    { m_bits = value ? m_bits | (quint64(1) << bit) : m_bits & ~(quint64(1) << bit); }
+    constexpr void clearBit(int bit) { m_bits &= ~(quint64(1) << bit); }
 
-    bool isSquareOccupied(Square square) const;
+    bool isSquareOccupied(Square square) const { return testBit(square.index()); }
+    void setSquare(Square square) { setBit(square.index()); }
 
-    SquareList occupiedSquares() const;
+    int first() const { return lowestBit(m_bits); }
+    int takeFirst() { int bit = lowestBit(m_bits); m_bits &= m_bits - 1; return bit; }
 
-    void setBoard(const SquareList &squareList);
-    void setSquare(Square square);
+    Iterator begin() const { return Iterator(m_bits); }
+    Iterator end() const { return Iterator(0); }
 
-    Square bitToSquare(int bit) const;
-    int squareToBit(Square square) const;
+    constexpr BitBoard operator&(const BitBoard &other) const { return BitBoard(m_bits & other.m_bits); }
+    constexpr BitBoard operator|(const BitBoard &other) const { return BitBoard(m_bits | other.m_bits); }
+    constexpr BitBoard operator^(const BitBoard &other) const { return BitBoard(m_bits ^ other.m_bits); }
+    constexpr BitBoard operator~() const { return BitBoard(~m_bits); }
+    constexpr BitBoard &operator&=(const BitBoard &other) { m_bits &= other.m_bits; return *this; }
+    constexpr BitBoard &operator|=(const BitBoard &other) { m_bits |= other.m_bits; return *this; }
+    constexpr BitBoard &operator^=(const BitBoard &other) { m_bits ^= other.m_bits; return *this; }
+    constexpr bool operator==(const BitBoard &other) const { return m_bits == other.m_bits; }
+    constexpr bool operator!=(const BitBoard &other) const { return m_bits != other.m_bits; }
+
+    static constexpr BitBoard fromBit(int bit) { return BitBoard(quint64(1) << bit); }
+    static Square bitToSquare(int bit) { return Square(bit % 8, bit / 8); }
+    static int squareToBit(Square square) { return square.index(); }
+
+    static int populationCount(quint64 bits);
+    static int lowestBit(quint64 bits);
+
+private:
+    quint64 m_bits;
 };
 
+inline int BitBoard::populationCount(quint64 bits)
+{
+#if defined(Q_CC_GNU) || defined(Q_CC_CLANG)
+    return __builtin_popcountll(bits);
+#elif defined(Q_CC_MSVC) && defined(Q_PROCESSOR_X86_64)
+    return int(__popcnt64(bits));
+#else
+    int count = 0;
+    for (; bits; bits &= bits - 1)
+        ++count;
+    return count;
+#endif
+}
+
+inline int BitBoard::lowestBit(quint64 bits)
+{
+    Q_ASSERT(bits);
+#if defined(Q_CC_GNU) || defined(Q_CC_CLANG)
+    return __builtin_ctzll(bits);
+#elif defined(Q_CC_MSVC) && defined(Q_PROCESSOR_X86_64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return int(index);
+#else
+    int index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
 QDebug operator<<(QDebug, const BitBoard &);
 
 #endif
@@ -121,17 +121,11 @@ void Board::resetBoard()
 {
     clearBoard();
 
-    PieceList whitePieces = game()->pieces(White);
-    PieceList::ConstIterator it = whitePieces.begin();
-    for (; it != whitePieces.end(); ++it) {
-        addItem(new BoardPiece(this, (*it), QSizeF(SQUARE_SIZE, SQUARE_SIZE)));
-    }
+    foreach (Piece piece, game()->pieces(White))
+        addItem(new BoardPiece(this, piece, QSizeF(SQUARE_SIZE, SQUARE_SIZE)));
 
-    PieceList blackPieces = game()->pieces(Black);
-    PieceList::ConstIterator it2 = blackPieces.begin();
-    for (; it2 != blackPieces.end(); ++it2) {
-        addItem(new BoardPiece(this, (*it2), QSizeF(SQUARE_SIZE, SQUARE_SIZE)));
-    }
+    foreach (Piece piece, game()->pieces(Black))
+        addItem(new BoardPiece(this, piece, QSizeF(SQUARE_SIZE, SQUARE_SIZE)));
 
     MoveItem *move = game()->moves()->lastMove();
     if (!move) {
@@ -140,15 +134,13 @@ void Board::resetBoard()
     }
 
     m_squareBorders.clear();
-    if (move->move().start().isValid())
-        m_squareBorders.insert(move->move().start(), Qt::red);
-    if (move->move().end().isValid())
-        m_squareBorders.insert(move->move().end(), Qt::red);
+    m_squareBorders.insert(BitBoard::bitToSquare(move->move().from()), Qt::red);
+    m_squareBorders.insert(BitBoard::bitToSquare(move->move().to()), Qt::red);
     m_borders->update();
 
     QString status = QString("%1. %2%3").arg(QString::number(game()->fullMoveNumber()))
                                         .arg(game()->activeArmy() == White ? "... " : "")
-                                        .arg(Notation::moveToString(move->move()));
+                                        .arg(move->text());
     chessApp->showStatus(status, 0);
 }
 
@@ -190,18 +182,15 @@ void Board::resetSquares()
 
 void Board::colorBoard(Theme::SquareType type, const BitBoard &board)
 {
-    for (int i = 0; i < board.count(); i++) {
-        if (board.testBit(i)) {
-            int index = i;
-            if (armyInFront() == Black) {
-                Square s = board.bitToSquare(i);
-                Square inverted(7 - s.file(), 7 - s.rank());
-                index = inverted.index();
-            }
-            BoardSquare *sq = m_squares.value(index);
-            Q_ASSERT(sq);
-            sq->setSquareType(type);
+    foreach (Square s, board) {
+        int index = s.index();
+        if (armyInFront() == Black) {
+            Square inverted(7 - s.file(), 7 - s.rank());
+            index = inverted.index();
         }
+        BoardSquare *sq = m_squares.value(index);
+        Q_ASSERT(sq);
+        sq->setSquareType(type);
     }
 }
 
@@ -350,10 +339,7 @@ void Board::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
         return;
     }
 
-    Move move;
-    move.setPiece(piece->piece().piece());
-    move.setStart(Square(startF, startR));
-    move.setEnd(Square(endF, endR));
+    PackedMove move(Square(startF, startR).index(), Square(endF, endR).index());
 
     m_squareBorders.insert(Square(endF, endR), Qt::red);
     m_borders->update();
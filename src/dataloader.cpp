@@ -4,18 +4,28 @@
 #include <QFile>
 #include <QDebug>
 
+#include <limits.h>
+
 DataLoader::DataLoader(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_map(0)
 {
     m_manager = new QNetworkAccessManager(this);
 }
 
 DataLoader::~DataLoader()
 {
+    release();
 }
 
 void DataLoader::loadDataFromPath(const QString &path)
 {
+    //whoever got the last data may still be reading it
+    if (isHoldingData()) {
+        emit error("Still busy with the last file!");
+        return;
+    }
+
     QFile file(path);
     if (file.exists()) {
         loadFromDisk(path);
@@ -26,12 +36,46 @@ void DataLoader::loadDataFromPath(const QString &path)
 
 void DataLoader::loadFromDisk(const QString &path)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    //binary mode, text mode would have to copy everything to drop the carriage returns
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
         emit error("Could not open file for reading!");
         return;
     }
-    emit finished(file.readAll());
+
+    qint64 size = m_file.size();
+    if (size > 0)
+        m_map = m_file.map(0, size);
+
+    //some file systems cannot be mapped, those are read the old way
+    if (!m_map) {
+        //a QByteArray cannot span more than an int can count
+        if (size > INT_MAX) {
+            m_file.close();
+            emit error("File is too large to load without mapping it!");
+            return;
+        }
+        m_buffer = m_file.readAll();
+        m_file.close();
+        emit finished(m_buffer.constData(), m_buffer.size());
+        return;
+    }
+    emit finished(reinterpret_cast<const char*>(m_map), size);
+}
+
+void DataLoader::release()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+    m_map = 0;
+    if (m_file.isOpen())
+        m_file.close();
+    m_buffer.clear();
+}
+
+bool DataLoader::isHoldingData() const
+{
+    return m_map || !m_buffer.isNull();
 }
 
 void DataLoader::loadFromInternet(const QString &path)
@@ -56,7 +100,13 @@ void DataLoader::replyFinished(QNetworkReply *reply)
 {
     if (reply->error() != QNetworkReply::NoError)
         return;
-    emit finished(reply->readAll());
+    if (isHoldingData()) {
+        emit error("Still busy with the last file!");
+        reply->deleteLater();
+        return;
+    }
+    m_buffer = reply->readAll();
+    emit finished(m_buffer.constData(), m_buffer.size());
     reply->deleteLater();
     reply = 0;
 }
@@ -2,10 +2,18 @@
 #define DATALOADER_H
 
 #include <QObject>
+#include <QFile>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QNetworkAccessManager>
 
+/*
+ * Files on disk are memory mapped and handed on without copying, so the
+ * data emitted by finished() points into the mapping.  A mapping is not
+ * limited to what a QByteArray can hold, so multi-gigabyte files load too.
+ * The data stays valid until release() is called or the loader is
+ * destroyed, and no other file can be loaded until then.
+ */
 class DataLoader : public QObject {
     Q_OBJECT
 public:
@@ -14,10 +22,13 @@ public:
 
     void loadDataFromPath(const QString &path);
 
+public Q_SLOTS:
+    void release();
+
 Q_SIGNALS:
     void progress(qint64 bytesReceived, qint64 bytesTotal);
     void error(const QString &error);
-    void finished(const QByteArray &array);
+    void finished(const char *data, qint64 size);
 
 private Q_SLOTS:
     void replyFinished(QNetworkReply *reply);
@@ -26,9 +37,13 @@ private Q_SLOTS:
 private:
     void loadFromDisk(const QString &path);
     void loadFromInternet(const QString &path);
+    bool isHoldingData() const;
 
 private:
     QNetworkAccessManager *m_manager;
+    QFile m_file;
+    uchar *m_map;
+    QByteArray m_buffer;    //what was read when mapping was not possible
 };
 
 #endif
@@ -0,0 +1,301 @@
+#include "fen.h"
+
+#include <QObject>
+
+#include "position.h"
+
+using namespace Chess;
+
+static const char s_pieceLetters[] = " KQRBNP";
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline Fen::Error failAt(Fen::Error error, const char *data, const char *p, int *errorOffset)
+{
+    if (errorOffset)
+        *errorOffset = int(p - data);
+    return error;
+}
+
+static PieceType letterToPiece(char letter)
+{
+    switch (letter | 0x20) {
+    case 'k': return King;
+    case 'q': return Queen;
+    case 'r': return Rook;
+    case 'b': return Bishop;
+    case 'n': return Knight;
+    case 'p': return Pawn;
+    default: return Unknown;
+    }
+}
+
+/* reads a clock of at most nine digits so it cannot overflow */
+static const char *parseNumber(const char *p, const char *end, int *number)
+{
+    const char *start = p;
+    int value = 0;
+    while (p < end && p - start < 9 && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    if (p == start || (p < end && *p >= '0' && *p <= '9'))
+        return 0;
+    *number = value;
+    return p;
+}
+
+static char *writeNumber(char *p, int number)
+{
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = char('0' + number % 10);
+        number /= 10;
+    } while (number > 0 && count < 10);
+    while (count > 0)
+        *p++ = digits[--count];
+    return p;
+}
+
+Fen::Error Fen::parse(const char *data, int length, Position *position, int *errorOffset)
+{
+    Position result;
+    const char *p = data;
+    const char *end = data + length;
+
+    int rank = 7;
+    int file = 0;
+    bool lastWasDigit = false;
+    for (; p < end && *p != ' '; ++p) {
+        char c = *p;
+        if (c == '/') {
+            if (file != 8 || rank == 0)
+                return failAt(BadPlacement, data, p, errorOffset);
+            --rank;
+            file = 0;
+            lastWasDigit = false;
+        } else if (c >= '1' && c <= '8') {
+            //two digits in a row are legal nowhere
+            file += c - '0';
+            if (lastWasDigit || file > 8)
+                return failAt(BadPlacement, data, p, errorOffset);
+            lastWasDigit = true;
+        } else {
+            PieceType piece = letterToPiece(c);
+            if (piece == Unknown || file > 7)
+                return failAt(BadPlacement, data, p, errorOffset);
+            Army army = c & 0x20 ? Black : White;
+            if (piece == Pawn && (rank == 0 || rank == 7))
+                return failAt(BadPawns, data, p, errorOffset);
+            if (piece == King && !result.pieces(army, King).isClear())
+                return failAt(BadKings, data, p, errorOffset);
+            //more cannot come from a legal game, and the material key only counts to 15
+            if (result.pieces(army).count() == 16 || (piece == Pawn && result.pieces(army, Pawn).count() == 8))
+                return failAt(TooManyPieces, data, p, errorOffset);
+            result.addPiece(army, piece, rank * 8 + file++);
+            lastWasDigit = false;
+        }
+    }
+    if (rank != 0 || file != 8)
+        return failAt(p == end ? MissingField : BadPlacement, data, p, errorOffset);
+    if (result.kingSquare(White) < 0 || result.kingSquare(Black) < 0)
+        return failAt(BadKings, data, p, errorOffset);
+
+    if (end - p < 2)
+        return failAt(MissingField, data, p, errorOffset);
+    ++p;
+    if (*p == 'w')
+        result.setActiveArmy(White);
+    else if (*p == 'b')
+        result.setActiveArmy(Black);
+    else
+        return failAt(BadActiveArmy, data, p, errorOffset);
+
+    //otherwise the king could be captured and the move generator has nothing sensible to do
+    Army enemy = result.activeArmy() == White ? Black : White;
+    BitBoard checkers = result.attackersTo(result.kingSquare(enemy), result.occupied())
+                        & result.pieces(result.activeArmy());
+    if (!checkers.isClear())
+        return failAt(OpponentInCheck, data, p, errorOffset);
+    ++p;
+    if (p < end && *p != ' ')
+        return failAt(BadActiveArmy, data, p, errorOffset);
+
+    //KQkq picks the outermost rook like X-FEN, a file letter names the rook like Shredder-FEN
+    if (end - p < 2)
+        return failAt(MissingField, data, p, errorOffset);
+    ++p;
+    if (*p == '-') {
+        ++p;
+    } else {
+        for (; p < end && *p != ' '; ++p) {
+            Army army = *p & 0x20 ? Black : White;
+            char letter = *p | 0x20;
+            int king = result.kingSquare(army);
+            int backRank = army == White ? 0 : 56;
+            if (king < 0 || king / 8 != backRank / 8)
+                return failAt(BadCastling, data, p, errorOffset);
+
+            BitBoard rooks = result.pieces(army, Rook);
+            int rook = -1;
+            if (letter == 'k') {
+                for (int f = 7; f > king % 8 && rook < 0; --f)
+                    rook = rooks.testBit(backRank + f) ? backRank + f : -1;
+            } else if (letter == 'q') {
+                for (int f = 0; f < king % 8 && rook < 0; ++f)
+                    rook = rooks.testBit(backRank + f) ? backRank + f : -1;
+            } else if (letter >= 'a' && letter <= 'h' && rooks.testBit(backRank + letter - 'a')) {
+                rook = backRank + letter - 'a';
+            }
+
+            Castle castle = rook > king ? KingSide : QueenSide;
+            if (rook < 0 || result.castlingRook(army, castle) >= 0)
+                return failAt(BadCastling, data, p, errorOffset);
+            result.setCastlingRook(army, castle, rook);
+        }
+    }
+    if (p < end && *p != ' ')
+        return failAt(BadCastling, data, p, errorOffset);
+
+    //the square behind a pawn that just moved two, so it depends on who moves next
+    if (end - p < 2)
+        return failAt(MissingField, data, p, errorOffset);
+    ++p;
+    if (*p == '-') {
+        ++p;
+    } else {
+        char rankLetter = result.activeArmy() == White ? '6' : '3';
+        if (end - p < 2 || p[0] < 'a' || p[0] > 'h' || p[1] != rankLetter)
+            return failAt(BadEnPassant, data, p, errorOffset);
+
+        //only a pawn that really just made a double step leaves a target behind
+        int square = (p[1] - '1') * 8 + p[0] - 'a';
+        int step = result.activeArmy() == White ? 8 : -8;
+        if (!result.isEmpty(square) || !result.isEmpty(square + step)
+            || !result.pieces(enemy, Pawn).testBit(square - step))
+            return failAt(BadEnPassant, data, p, errorOffset);
+        result.setEnPassantSquare(square);
+        p += 2;
+    }
+    if (p < end && !isSpace(*p))
+        return failAt(BadEnPassant, data, p, errorOffset);
+
+    //the clocks are often left off by hand written FEN and by EPD
+    if (end - p > 1 && *p == ' ' && p[1] >= '0' && p[1] <= '9') {
+        int halfMoveClock = 0;
+        const char *next = parseNumber(p + 1, end, &halfMoveClock);
+        if (!next)
+            return failAt(BadClock, data, p + 1, errorOffset);
+        p = next;
+        result.setHalfMoveClock(halfMoveClock);
+
+        if (end - p > 1 && *p == ' ' && p[1] >= '0' && p[1] <= '9') {
+            int fullMoveNumber = 0;
+            next = parseNumber(p + 1, end, &fullMoveNumber);
+            if (!next)
+                return failAt(BadClock, data, p + 1, errorOffset);
+            p = next;
+            result.setFullMoveNumber(qMax(1, fullMoveNumber));
+        }
+    }
+
+    for (; p < end; ++p) {
+        if (!isSpace(*p))
+            return failAt(TrailingCharacters, data, p, errorOffset);
+    }
+
+    *position = result;
+    if (errorOffset)
+        *errorOffset = -1;
+    return NoError;
+}
+
+int Fen::write(const Position &position, char *buffer, int size, bool isChess960)
+{
+    Q_ASSERT(size >= BufferSize);
+    if (size < BufferSize)
+        return 0;
+
+    char *p = buffer;
+    for (int rank = 7; rank >= 0; --rank) {
+        int blank = 0;
+        for (int file = 0; file < 8; ++file) {
+            int square = rank * 8 + file;
+            if (position.isEmpty(square)) {
+                ++blank;
+                continue;
+            }
+            if (blank > 0)
+                *p++ = char('0' + blank);
+            blank = 0;
+            char letter = s_pieceLetters[position.pieceAt(square)];
+            *p++ = position.armyAt(square) == White ? letter : char(letter | 0x20);
+        }
+        if (blank > 0)
+            *p++ = char('0' + blank);
+        if (rank > 0)
+            *p++ = '/';
+    }
+
+    *p++ = ' ';
+    *p++ = position.activeArmy() == White ? 'w' : 'b';
+
+    *p++ = ' ';
+    char *castling = p;
+    for (int army = White; army <= Black; ++army) {
+        for (int castle = KingSide; castle <= QueenSide; ++castle) {
+            int rook = position.castlingRook(Army(army), Castle(castle));
+            if (rook < 0)
+                continue;
+            char letter = isChess960 ? char('a' + rook % 8) : (castle == KingSide ? 'k' : 'q');
+            *p++ = army == White ? char(letter & ~0x20) : letter;
+        }
+    }
+    if (p == castling)
+        *p++ = '-';
+
+    *p++ = ' ';
+    int enPassant = position.enPassantSquare();
+    if (enPassant >= 0) {
+        *p++ = char('a' + enPassant % 8);
+        *p++ = char('1' + enPassant / 8);
+    } else {
+        *p++ = '-';
+    }
+
+    *p++ = ' ';
+    p = writeNumber(p, qMax(0, position.halfMoveClock()));
+    *p++ = ' ';
+    p = writeNumber(p, qMax(1, position.fullMoveNumber()));
+    *p = '\0';
+    return int(p - buffer);
+}
+
+QString Fen::errorString(Error error)
+{
+    switch (error) {
+    case NoError: return QString();
+    case MissingField: return QObject::tr("FEN is missing a field.");
+    case BadPlacement: return QObject::tr("Piece placement in FEN is invalid.");
+    case BadKings: return QObject::tr("FEN must have exactly one king of each color.");
+    case BadPawns: return QObject::tr("FEN has a pawn on the first or last rank.");
+    case TooManyPieces: return QObject::tr("FEN has more than 16 pieces or 8 pawns of one color.");
+    case BadActiveArmy: return QObject::tr("Active color in FEN must be 'w' or 'b'.");
+    case OpponentInCheck: return QObject::tr("The side not to move is in check in FEN.");
+    case BadCastling: return QObject::tr("Castling availability in FEN is invalid.");
+    case BadEnPassant: return QObject::tr("En passant target square in FEN is invalid.");
+    case BadClock: return QObject::tr("Move clocks in FEN are invalid.");
+    case TrailingCharacters: return QObject::tr("FEN has unexpected characters at the end.");
+    default: return QString();
+    }
+}
+
+Fen::Fen()
+{
+}
+
+Fen::~Fen()
+{
+}
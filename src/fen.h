@@ -0,0 +1,47 @@
+#ifndef FEN_H
+#define FEN_H
+
+#include <QString>
+
+class Position;
+
+/*
+ * Reads and writes Forsyth-Edwards Notation straight from and into Latin-1
+ * bytes.  Nothing is allocated either way, so whole EPD/FEN files can be
+ * streamed through it.  Reading is strict and reports the offset of the
+ * first byte it could not accept.
+ */
+class Fen {
+public:
+    enum Error
+    {
+        NoError,
+        MissingField,
+        BadPlacement,
+        BadKings,           //each army needs exactly one king
+        BadPawns,           //pawns cannot stand on the first or last rank
+        TooManyPieces,      //at most 16 pieces and 8 pawns per army
+        BadActiveArmy,
+        OpponentInCheck,    //the army not to move cannot be in check
+        BadCastling,
+        BadEnPassant,
+        BadClock,
+        TrailingCharacters
+    };
+
+    /* enough for any position with nine digit clocks and a terminating zero */
+    enum { BufferSize = 128 };
+
+    static Error parse(const char *data, int length, Position *position, int *errorOffset = 0);
+
+    /* returns the length written, not counting the terminating zero */
+    static int write(const Position &position, char *buffer, int size, bool isChess960 = false);
+
+    static QString errorString(Error error);
+
+private:
+    Fen();
+    ~Fen();
+};
+
+#endif
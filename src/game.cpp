@@ -7,8 +7,10 @@
 
 #include "rules.h"
 #include "clock.h"
+#include "fen.h"
 #include "player.h"
 #include "notation.h"
+#include "movegenerator.h"
 #include "bitboard.h"
 #include "resource.h"
 #include "movesmodel.h"
@@ -20,15 +22,14 @@ using namespace Chess;
 Game::Game(QObject *parent)
     : QObject(parent),
       m_index(0),
-      m_activeArmy(White),
       m_isChess960(false),
       m_isScratchGame(false),
-      m_halfMoveClock(0),
-      m_fullMoveNumber(1),
       m_fileOfKingsRook(0),
       m_fileOfQueensRook(0),
       m_ending(InProgress),
-      m_result(NoResult)
+      m_result(NoResult),
+      m_fenError(Fen::NoError),
+      m_fenErrorOffset(-1)
 {
     m_rules = new Rules(this);
     m_clock = new Clock(this);
@@ -38,9 +39,10 @@ Game::Game(QObject *parent)
     //fen = QLatin1String("3R4/2b2pkp/2r3p1/8/1P5P/2P2N2/5PK1/8 w -- - 0 1");
 
     int oldIndex = m_index;
-    m_index = m_mapOfFen.count();
-    m_mapOfFen.insert(m_index, fen);
-    setFen(fen);
+    m_index = m_history.count();
+    m_fenError = setFen(fen, &m_fenErrorOffset);
+    m_history.append(m_position);
+    recordKey();
     emit positionChanged(oldIndex, m_index);
 
     m_rules->refreshBoards();
@@ -49,24 +51,24 @@ Game::Game(QObject *parent)
 Game::Game(QObject *parent, const QString &fen)
     : QObject(parent),
       m_index(0),
-      m_activeArmy(White),
       m_isChess960(false),
       m_isScratchGame(false),
-      m_halfMoveClock(0),
-      m_fullMoveNumber(1),
       m_fileOfKingsRook(0),
       m_fileOfQueensRook(0),
       m_ending(InProgress),
-      m_result(NoResult)
+      m_result(NoResult),
+      m_fenError(Fen::NoError),
+      m_fenErrorOffset(-1)
 {
     m_rules = new Rules(this);
     m_clock = new Clock(this);
     m_moves = new MovesModel(this);
 
     int oldIndex = m_index;
-    m_index = m_mapOfFen.count();
-    m_mapOfFen.insert(m_index, fen);
-    setFen(fen);
+    m_index = m_history.count();
+    m_fenError = setFen(fen, &m_fenErrorOffset);
+    m_history.append(m_position);
+    recordKey();
     emit positionChanged(oldIndex, m_index);
 
     m_rules->refreshBoards();
@@ -78,7 +80,7 @@ Game::~Game()
 
 int Game::count()
 {
-    return m_mapOfFen.count();
+    return m_history.count();
 }
 
 int Game::position() const
@@ -88,22 +90,36 @@ int Game::position() const
 
 void Game::setPosition(int index)
 {
-    if (m_mapOfFen.contains(index)) {
+    if (index >= 0 && index < m_history.count()) {
         int oldIndex = m_index;
         m_index = index;
-        setFen(m_mapOfFen.value(index));
+        setCurrentPosition(m_history.at(index));
         emit positionChanged(oldIndex, m_index);
     }
 }
 
 QString Game::fen(int index) const
 {
-    if (m_mapOfFen.contains(index)) {
-        return m_mapOfFen.value(index);
+    if (index >= 0 && index < m_history.count()) {
+        return m_history.at(index).toFen(isChess960());
     }
     return QString();
 }
 
+bool Game::isRepetition(int times) const
+{
+    //nothing before the last capture or pawn move can repeat, and only
+    //every other position has the same side to move
+    int plies = qMin(qMin(halfMoveClock(), m_index), int(KeyHistorySize) - 1);
+    quint64 key = m_keyHistory[m_index % KeyHistorySize];
+    int seen = 1;
+    for (int ply = 2; ply <= plies && seen < times; ply += 2) {
+        if (m_keyHistory[(m_index - ply) % KeyHistorySize] == key)
+            ++seen;
+    }
+    return seen >= times;
+}
+
 void Game::setScratchGame(bool isScratchGame)
 {
     m_isScratchGame = isScratchGame;
@@ -113,14 +129,6 @@ void Game::setScratchGame(bool isScratchGame)
     }
 }
 
-PieceList Game::pieces(Chess::Army army) const
-{
-    if (army == White)
-        return m_whitePieces.values();
-    else
-        return m_blackPieces.values();
-}
-
 PieceList Game::capturedPieces(Chess::Army army) const
 {
     if (army == White)
@@ -155,8 +163,8 @@ bool Game::startGame()
         connect(m_black, SIGNAL(ready()), this, SLOT(playerReady()));
     }
 
-    connect(m_white, SIGNAL(madeMove(Move)), this, SLOT(playerMadeMove(Move)));
-    connect(m_black, SIGNAL(madeMove(Move)), this, SLOT(playerMadeMove(Move)));
+    connect(m_white, SIGNAL(madeMove(PackedMove)), this, SLOT(playerMadeMove(PackedMove)));
+    connect(m_black, SIGNAL(madeMove(PackedMove)), this, SLOT(playerMadeMove(PackedMove)));
     emit gameStarted();
     return true;
 }
@@ -164,8 +172,8 @@ bool Game::startGame()
 bool Game::endGame(Ending ending, Result result)
 {
     m_clock->endClock();
-    disconnect(m_white, SIGNAL(madeMove(Move)), this, SLOT(playerMadeMove(Move)));
-    disconnect(m_black, SIGNAL(madeMove(Move)), this, SLOT(playerMadeMove(Move)));
+    disconnect(m_white, SIGNAL(madeMove(PackedMove)), this, SLOT(playerMadeMove(PackedMove)));
+    disconnect(m_black, SIGNAL(madeMove(PackedMove)), this, SLOT(playerMadeMove(PackedMove)));
     m_ending = ending;
     m_result = result;
     emit gameEnded();
@@ -174,31 +182,20 @@ bool Game::endGame(Ending ending, Result result)
 
 bool Game::restartGame()
 {
-    QString fen = stateOfGameToFen();
-    m_activeArmy = White;
-
     m_isScratchGame = false;
 
-    m_halfMoveClock = 0;
-    m_fullMoveNumber = 1;
     m_fileOfKingsRook = 0;
     m_fileOfQueensRook = 0;
     m_ending = Game::InProgress;
     m_result = Game::NoResult;
 
-    m_enPassantTarget = Square();
-    m_whitePieces.clear();
-    m_blackPieces.clear();
     m_whiteCapturedPieces.clear();
     m_blackCapturedPieces.clear();
 
-    foreach (int i, m_mapOfFen.keys()) {
-        if (i > m_index) {
-            m_mapOfFen.remove(i);
-        }
-    }
+    m_history.resize(m_index + 1);
 
-    setFen(fen);
+    setCurrentPosition(m_history.at(m_index));
+    refreshKeyHistory();
 
     m_rules->refreshBoards();
     m_moves->clear(m_index);
@@ -213,12 +210,12 @@ void Game::playerReady()
     Player *player = qobject_cast<Player*>(sender());
     Q_ASSERT(player);
     player->startGame();
-    if (player->army() == m_activeArmy) {
+    if (player->army() == activeArmy()) {
         player->makeNextMove();
     }
 }
 
-void Game::playerMadeMove(Move move)
+void Game::playerMadeMove(PackedMove move)
 {
     Player *player = qobject_cast<Player*>(sender());
     Q_ASSERT(player);
@@ -229,7 +226,7 @@ void Game::playerMadeMove(Move move)
         remoteOrEngineMadeMove(player->army(), move);
 }
 
-bool Game::localHumanMadeMove(Chess::Army army, Move move)
+bool Game::localHumanMadeMove(Chess::Army army, PackedMove move)
 {
     if (m_ending != InProgress && !m_isScratchGame)
         return false;
@@ -240,13 +237,13 @@ bool Game::localHumanMadeMove(Chess::Army army, Move move)
         return true;
     }
 
-    if (m_activeArmy != army)
+    if (activeArmy() != army)
         return false;
 
-    if (m_activeArmy == White && (!m_white || !m_white->isHuman() || m_white->isRemote()))
+    if (activeArmy() == White && (!m_white || !m_white->isHuman() || m_white->isRemote()))
         return false;
 
-    if (m_activeArmy == Black && (!m_black || !m_black->isHuman() || m_black->isRemote()))
+    if (activeArmy() == Black && (!m_black || !m_black->isHuman() || m_black->isRemote()))
         return false;
 
     bool ok = fillOutMove(army, &move);
@@ -260,12 +257,12 @@ bool Game::localHumanMadeMove(Chess::Army army, Move move)
     return true;
 }
 
-bool Game::remoteOrEngineMadeMove(Chess::Army army, Move move)
+bool Game::remoteOrEngineMadeMove(Chess::Army army, PackedMove move)
 {
     if (m_ending != InProgress && !m_isScratchGame)
         return false;
 
-    if (m_activeArmy != army)
+    if (activeArmy() != army)
         return false;
 
     bool ok = fillOutMove(army, &move);
@@ -275,7 +272,7 @@ bool Game::remoteOrEngineMadeMove(Chess::Army army, Move move)
     }
 
     if (!m_rules->isLegalMove(army, move)) {
-        qDebug() << "ERROR! attempted illegal move" << Notation::moveToString(move, Chess::Computer) << endl;
+        qDebug() << "ERROR! attempted illegal move" << Notation::moveToString(move, MoveAnnotation(), Chess::Computer, isChess960()) << endl;
         return false;
     }
 
@@ -283,184 +280,93 @@ bool Game::remoteOrEngineMadeMove(Chess::Army army, Move move)
     return true;
 }
 
-void Game::processMove(Chess::Army army, Move move)
+void Game::processMove(Chess::Army army, PackedMove move)
 {
-    setEnPassantTarget(Square());
-
-    if (army == White) {
-        qDebug() << "white moved" << Notation::moveToString(move, Chess::Computer) << endl;
-
-        if (move.piece() == King) {
-            m_rules->setCastleAvailable(White, KingSide, false);
-            m_rules->setCastleAvailable(White, QueenSide, false);
-        } else if (move.piece() == Rook) {
-            if (move.start() == Square(m_fileOfQueensRook, 0))
-                m_rules->setCastleAvailable(White, QueenSide, false);
-            else if (move.start() == Square(m_fileOfKingsRook, 0))
-                m_rules->setCastleAvailable(White, KingSide, false);
-        } else if (move.piece() == Pawn && qAbs(move.start().rank() - move.end().rank()) == 2) {
-            setEnPassantTarget(Square(move.end().file(), move.end().rank() - 1));
-        }
-
-        int start = move.start().index();
-        int end = move.end().index();
-
-        bool capture = m_blackPieces.contains(end) || move.isEnPassant();
-        move.setCapture(capture);
-        if (capture) {
-            int capturedPieceIndex = end;
-            if (move.isEnPassant())
-                capturedPieceIndex = Square(move.end().file(), move.end().rank() - 1).index();
-            Piece piece = m_blackPieces.take(capturedPieceIndex);
-            m_blackCapturedPieces << piece;
-            emit capturedPiecesChanged(); //FIXME need to reset state with new fen??
-        }
-
-        if (move.piece() != Pawn && !capture) {
-            setHalfMoveClock(halfMoveClock() + 1);
-        } else {
-            setHalfMoveClock(0);
-        }
-
-        if (move.isCastle()) { //have to move the rook
-            if (move.isKingSideCastle()) {
-                Piece rook = m_whitePieces.take(Square(m_fileOfKingsRook, 0).index());
-                rook.setSquare(Square(5, 0)); //f1
-                m_whitePieces.insert(rook.square().index(), rook);
-            } else if (move.isQueenSideCastle()) {
-                Piece rook = m_whitePieces.take(Square(m_fileOfQueensRook, 0).index());
-                rook.setSquare(Square(3, 0)); //d1
-                m_whitePieces.insert(rook.square().index(), rook);
-            }
-        }
-
-        m_whitePieces.remove(start);
-        if (move.promotion() != Unknown)
-            m_whitePieces.insert(end, Piece(White, move.promotion(), move.end()));
-        else
-            m_whitePieces.insert(end, Piece(White, move.piece(), move.end()));
-    } else if (army == Black) {
-        qDebug() << "black moved" << Notation::moveToString(move, Chess::Computer) << endl;
-
-        if (move.piece() == King) {
-            m_rules->setCastleAvailable(Black, KingSide, false);
-            m_rules->setCastleAvailable(Black, QueenSide, false);
-        } else if (move.piece() == Rook) {
-            if (move.start() == Square(m_fileOfQueensRook, 7))
-                m_rules->setCastleAvailable(Black, QueenSide, false);
-            else if (move.start() == Square(m_fileOfKingsRook, 7))
-                m_rules->setCastleAvailable(Black, KingSide, false);
-        } else if (move.piece() == Pawn && qAbs(move.start().rank() - move.end().rank()) == 2) {
-            setEnPassantTarget(Square(move.end().file(), move.end().rank() + 1));
-        }
-
-        int start = move.start().index();
-        int end = move.end().index();
-
-        bool capture = m_whitePieces.contains(end) || move.isEnPassant();
-        move.setCapture(capture);
-        if (capture) {
-            int capturedPieceIndex = end;
-            if (move.isEnPassant())
-                capturedPieceIndex = Square(move.end().file(), move.end().rank() + 1).index();
-            Piece piece = m_whitePieces.take(capturedPieceIndex);
+    qDebug() << (army == White ? "white moved" : "black moved") << Notation::moveToString(move, MoveAnnotation(), Chess::Computer, isChess960()) << endl;
+
+    //the scratch board lets either army move whenever it likes
+    if (activeArmy() != army)
+        m_position.setActiveArmy(army);
+
+    int moveNumber = fullMoveNumber();
+    MoveAnnotation annotation(m_position.pieceAt(move.from()));
+    QString text = Notation::moveToString(m_position, move);
+
+    int victim = move.to();
+    if (move.type() == PackedMove::EnPassant)
+        victim = army == White ? victim - 8 : victim + 8;
+    bool capture = move.type() != PackedMove::Castling && !m_position.isEmpty(victim) &&
+                   m_position.armyAt(victim) != army;
+    annotation.setCapture(capture);
+    if (capture) {
+        Piece piece(m_position.armyAt(victim), m_position.pieceAt(victim), BitBoard::bitToSquare(victim));
+        if (piece.army() == White)
             m_whiteCapturedPieces << piece;
-            emit capturedPiecesChanged(); //FIXME need to reset state with new fen??
-        }
-
-        if (move.piece() != Pawn && !capture) {
-            setHalfMoveClock(halfMoveClock() + 1);
-        } else {
-            setHalfMoveClock(0);
-        }
-
-        if (move.isCastle()) { //have to move the rook
-            if (move.isKingSideCastle()) {
-                Piece rook = m_blackPieces.take(Square(m_fileOfKingsRook, 7).index());
-                rook.setSquare(Square(5, 7)); //f8
-                m_blackPieces.insert(rook.square().index(), rook);
-            } else if (move.isQueenSideCastle()) {
-                Piece rook = m_blackPieces.take(Square(m_fileOfQueensRook, 7).index());
-                rook.setSquare(Square(3, 7)); //d8
-                m_blackPieces.insert(rook.square().index(), rook);
-            }
-        }
-
-        m_blackPieces.remove(start);
-        if (move.promotion() != Unknown)
-            m_blackPieces.insert(end, Piece(Black, move.promotion(), move.end()));
         else
-            m_blackPieces.insert(end, Piece(Black, move.piece(), move.end()));
+            m_blackCapturedPieces << piece;
+        emit capturedPiecesChanged(); //FIXME need to reset state with new fen??
     }
 
+    m_position.makeMove(move);
+
+    for (int i = 0; i < 2; ++i) {
+        Army side = i == 0 ? White : Black;
+        m_rules->setCastleAvailable(side, KingSide, m_position.castlingRook(side, KingSide) >= 0);
+        m_rules->setCastleAvailable(side, QueenSide, m_position.castlingRook(side, QueenSide) >= 0);
+    }
     emit pieceMoved(); //rules and bitboards are processed here...
 
     bool check = m_rules->isChecked(army == White ? Black : White);
     bool checkMate = m_rules->isCheckMated(army == White ? Black : White);
-    move.setCheck(check);
-    move.setCheckMate(checkMate);
-
-    m_moves->addMove(fullMoveNumber(), army, move);
-    if (army == Black)
-        setFullMoveNumber(fullMoveNumber() + 1);
+    bool staleMate = !checkMate && m_rules->isStaleMated(army == White ? Black : White);
+    annotation.setCheck(check);
+    annotation.setCheckMate(checkMate);
 
-    m_activeArmy = m_activeArmy == White ? Black : White;
-
-    QString fen = stateOfGameToFen();
+    m_moves->addMove(moveNumber, army, move, annotation, text);
     int oldIndex = m_index;
-    m_index = m_mapOfFen.count();
-    m_mapOfFen.insert(m_index, fen);
-    setFen(fen);
+    m_index = m_history.count();
+    m_history.append(m_position);
+    setCurrentPosition(m_position);
+    recordKey();
     emit positionChanged(oldIndex, m_index);
 
     if (checkMate)
         endGame(CheckMate, army == White ? WhiteWins : BlackWins);
+    else if (staleMate)
+        endGame(StaleMate, Drawn);
+    else if (isRepetition())
+        endGame(Repetition, Drawn);
+    else if (m_position.isInsufficientMaterial())
+        endGame(InsufficientMaterial, Drawn);
 
-    m_clock->startClock(m_activeArmy);
+    m_clock->startClock(activeArmy());
 
     if (halfMoveClock() >= 49) {
         endGame(HalfMoveClock, Drawn);
-    } else if (m_activeArmy == White && m_white) {
+    } else if (activeArmy() == White && m_white) {
         m_white->makeNextMove();
-    } else if (m_activeArmy == Black && m_black) {
+    } else if (activeArmy() == Black && m_black) {
         m_black->makeNextMove();
     }
 }
 
-bool Game::fillOutMove(Chess::Army army, Move *move)
+bool Game::fillOutMove(Chess::Army army, PackedMove *move)
 {
-    if (move->isCastle() && !move->isValid()) {
-        if (move->isKingSideCastle())
-            move->setEnd(Square(6, army == White ? 0 : 7));
-        else if (move->isQueenSideCastle())
-            move->setEnd(Square(2, army == White ? 0 : 7));
-    }
-
-    if (!move->isValid()) {
+    if (move->isNull()) {
         qDebug() << "invalid move..." << endl;
         return false; //not enough info to do anything
     }
 
-    if (move->piece() == Unknown) {
-        int start = move->start().index();
-        if (m_whitePieces.contains(start)) {
-            PieceType piece = m_whitePieces.value(start).piece();
-            move->setPiece(piece);
-        } else if (m_blackPieces.contains(start)) {
-            PieceType piece = m_blackPieces.value(start).piece();
-            move->setPiece(piece);
-        }
-    }
+    //moves from notation arrive complete, only plain start and end squares need work
+    if (move->type() != PackedMove::Normal)
+        return true;
 
-    if (!move->start().isValid()) {
-        bool ok = fillOutStart(army, move);
-        if (!ok)
-            return false;
-    }
+    int from = move->from();
+    int to = move->to();
+    Square end(to % 8, to / 8);
+    PieceType piece = m_position.pieceAt(from);
 
-    if (move->piece() == Pawn && move->promotion() == Unknown &&
-        ((army == White && move->end().rank() == 7) ||
-         (army == Black && move->end().rank() == 0))) {
+    if (piece == Pawn && ((army == White && end.rank() == 7) || (army == Black && end.rank() == 0))) {
 
         //FIXME don't allow 'cancel' button...
         QStringList pieces;
@@ -469,225 +375,96 @@ bool Game::fillOutMove(Chess::Army army, Move *move)
                                                   tr("Promote Pawn"),
                                                   tr("Choose Piece:"),
                                                   pieces, 0, false);
-        if (promotion == tr("Queen"))
-            move->setPromotion(Queen);
-        else if (promotion == tr("Rook"))
-            move->setPromotion(Rook);
+        if (promotion == tr("Rook"))
+            *move = PackedMove(from, to, PackedMove::Promotion, Rook);
         else if (promotion == tr("Bishop"))
-            move->setPromotion(Bishop);
+            *move = PackedMove(from, to, PackedMove::Promotion, Bishop);
         else if (promotion == tr("Knight"))
-            move->setPromotion(Knight);
+            *move = PackedMove(from, to, PackedMove::Promotion, Knight);
         else
-            move->setPromotion(Queen);
+            *move = PackedMove(from, to, PackedMove::Promotion, Queen);
     }
 
-    if (move->piece() == Pawn && move->end() == m_enPassantTarget) {
-        move->setEnPassant(true);
+    if (piece == Pawn && end == enPassantTarget()) {
+        *move = PackedMove(from, to, PackedMove::EnPassant);
     }
 
-    if (move->piece() == King) {
+    if (piece == King && end.rank() == from / 8 && (end.rank() == 0 || end.rank() == 7)) {
 
-        //FIXME ...this is different for Chess960...
+        //castling is the king taking its own rook, which is also how UCI_Chess960 sends it
+        int kingsRook = Square(m_fileOfKingsRook, end.rank()).index();
+        int queensRook = Square(m_fileOfQueensRook, end.rank()).index();
+        int rook = -1;
+        if (to == kingsRook || to == queensRook)
+            rook = to;
 
-        if ((move->start().rank() == 0 || move->start().rank() == 7) && move->start().file() == 4) {
-            if (move->end().file() == 6) {
-                move->setCastle(true);
-                move->setCastleSide(KingSide);
-            } else if (move->end().file() == 2) {
-                move->setCastle(true);
-                move->setCastleSide(QueenSide);
-            }
-        }
+        //otherwise the king was put where castling leaves it, in Chess960 that can be a plain king move too
+        else if (end.file() == 6 && !MoveGenerator::isLegalMove(m_position, *move))
+            rook = kingsRook;
+        else if (end.file() == 2 && !MoveGenerator::isLegalMove(m_position, *move))
+            rook = queensRook;
+
+        if (rook != -1 && m_position.pieceAt(rook) == Rook && m_position.armyAt(rook) == army)
+            *move = PackedMove(from, rook, PackedMove::Castling);
     }
 
     return true;
 }
 
-bool Game::fillOutStart(Chess::Army army, Move *move)
+Square Game::enPassantTarget() const
 {
-    if (!move->isValid()) {
-        qDebug() << "invalid move..." << endl;
-        return false; //not enough info to do anything
-    }
-
-    Square square = m_rules->guessSquare(army, *move);
-    if (square.isValid()) {
-        move->setStart(square);
-        return true;
-    }
-
-    BitBoard positions(m_rules->bitBoard(move->piece(), Positions) & m_rules->bitBoard(army, Positions));
-    BitBoard opposingPositions(m_rules->bitBoard(army == White ? Black : White, Positions));
-
-    qDebug() << "could not find a valid start square..."
-             << "\narmy:" << (army == White ? "White" : "Black")
-             << "\nmove:" << Notation::moveToString(*move)
-             << "\npositions:" << positions
-             << "\nopposingPositions:" << opposingPositions
-             << endl;
-
-    Q_ASSERT(false);
-
-    return false;
+    int square = m_position.enPassantSquare();
+    return square >= 0 ? BitBoard::bitToSquare(square) : Square();
 }
 
-void Game::setFen(const QString &fen)
+void Game::setEnPassantTarget(Square enPassantTarget)
 {
-    m_whitePieces.clear();
-    m_blackPieces.clear();
-
-    QStringList list = fen.split(' ');
-    Q_ASSERT(list.count() == 6);
-
-    QStringList ranks = list.at(0).split('/');
-    Q_ASSERT(ranks.count() == 8);
-
-    for (int i = 0; i < ranks.size(); ++i) {
-        QString rank = ranks.at(i);
-        int blank = 0;
-        for (int j = 0; j < rank.size(); ++j) {
-            QChar c = rank.at(j);
-            if (c.isLetter() && c.isUpper()) /*white*/ {
-                PieceType piece = Notation::charToPiece(c);
-                Square square = Square(j + blank, 7 - i);
-                m_whitePieces.insert(square.index(), Piece(White, piece, square));
-            } else if (c.isLetter() && c.isLower()) /*black*/ {
-                PieceType piece = Notation::charToPiece(c.toUpper());
-                Square square = Square(j + blank, 7 - i);
-                m_blackPieces.insert(square.index(), Piece(Black, piece, square));
-            } else if (c.isNumber()) /*blank*/ {
-                blank += QString(c).toInt() - 1;
-            }
-        }
-    }
+    m_position.setEnPassantSquare(enPassantTarget.isValid() ? enPassantTarget.index() : -1);
+}
 
-    m_activeArmy = list.at(1) == QLatin1String("w") ? White : Black;
+void Game::recordKey()
+{
+    m_keyHistory[m_index % KeyHistorySize] = m_position.key();
+}
 
-    //Should work for regular fen and UCI fen for chess960...
-    QString castling = list.at(2);
-    if (castling != "-") {
-        QList<QChar> whiteKingSide;
-        whiteKingSide << 'K';
-        if (isChess960()) whiteKingSide << 'E' << 'F' << 'G' << 'H';
-        m_rules->setCastleAvailable(White, KingSide, false);
-        foreach (QChar c, whiteKingSide) {
-            if (castling.contains(c)) {
-                m_rules->setCastleAvailable(White, KingSide, true);
-                m_fileOfKingsRook = isChess960() ? castling.indexOf(c) + 3 : 7;
-            }
-        }
-
-        QList<QChar> whiteQueenSide;
-        whiteQueenSide << 'Q';
-        if (isChess960()) whiteQueenSide << 'A' << 'B' << 'C' << 'D';
-        m_rules->setCastleAvailable(White, QueenSide, false);
-        foreach (QChar c, whiteQueenSide) {
-            if (castling.contains(c)) {
-                m_rules->setCastleAvailable(White, QueenSide, true);
-                m_fileOfQueensRook = isChess960() ? castling.indexOf(c) : 0;
-            }
-        }
-
-        QList<QChar> blackKingSide;
-        blackKingSide << 'k';
-        if (isChess960()) blackKingSide << 'e' << 'f' << 'g' << 'h';
-        m_rules->setCastleAvailable(Black, KingSide, false);
-        foreach (QChar c, blackKingSide) {
-            if (castling.contains(c)) {
-                m_rules->setCastleAvailable(Black, KingSide, true);
-                m_fileOfKingsRook = isChess960() ? castling.indexOf(c) + 3 : 7;
-            }
-        }
-
-        QList<QChar> blackQueenSide;
-        blackQueenSide << 'q';
-        if (isChess960()) blackQueenSide << 'a' << 'b' << 'c' << 'd';
-        m_rules->setCastleAvailable(Black, QueenSide, false);
-        foreach (QChar c, blackQueenSide) {
-            if (castling.contains(c)) {
-                m_rules->setCastleAvailable(Black, QueenSide, true);
-                m_fileOfQueensRook = isChess960() ? castling.indexOf(c) : 0;
-            }
-        }
-    }
+void Game::refreshKeyHistory()
+{
+    //after going back in the game the ring may hold keys of positions that were undone
+    for (int index = qMax(0, m_index - int(KeyHistorySize) + 1); index <= m_index; ++index)
+        m_keyHistory[index % KeyHistorySize] = m_history.at(index).key();
+}
 
-    QString enPassant = list.at(3);
-    if (enPassant != QLatin1String("-")) {
-        setEnPassantTarget(Notation::stringToSquare(enPassant));
+Fen::Error Game::setFen(const QString &fen, int *errorOffset)
+{
+    //the FEN may come from the user or a PGN file, so a bad one is reported rather than trusted
+    QByteArray latin1 = fen.toLatin1();
+    Position position;
+    Fen::Error error = Fen::parse(latin1.constData(), latin1.size(), &position, errorOffset);
+    if (error != Fen::NoError) {
+        static const char start[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+        Fen::parse(start, sizeof(start) - 1, &position);
     }
 
-    setHalfMoveClock(list.at(4).toInt());
-    setFullMoveNumber(list.at(5).toInt());
-
-    emit piecesChanged();
+    setCurrentPosition(position);
+    return error;
 }
 
-QString Game::stateOfGameToFen() const
+void Game::setCurrentPosition(const Position &position)
 {
+    m_position = position;
 
-    QStringList rankList;
-    for (int i = 0; i < 8; ++i) { //rank
-        QString rank;
-        int blank = 0;
-        for (int j = 0; j < 8; ++j) { //file
-            Square square(j, 7 - i);
-            int index = square.index();
-            if (m_whitePieces.contains(index)) {
-                Piece piece = m_whitePieces.value(index);
-                QChar ch = Notation::pieceToChar(piece.piece());
-                if (blank > 0) {
-                    rank += QString::number(blank);
-                    blank = 0;
-                }
-                if (!ch.isNull()) {
-                    rank += ch.toUpper();
-                } else {
-                    rank += 'P';
-                }
-            } else if (m_blackPieces.contains(index)) {
-                Piece piece = m_blackPieces.value(index);
-                QChar ch = Notation::pieceToChar(piece.piece());
-                if (blank > 0) {
-                    rank += QString::number(blank);
-                    blank = 0;
-                }
-                if (!ch.isNull()) {
-                    rank += ch.toLower();
-                } else {
-                    rank += 'p';
-                }
-            } else {
-                blank++;
-            }
-        }
-
-        if (blank > 0) {
-            rank += QString::number(blank);
-            blank = 0;
-        }
-
-        rankList << rank;
+    //Should work for regular fen and UCI fen for chess960...
+    for (int i = 0; i < 2; ++i) {
+        Army army = i == 0 ? White : Black;
+        int kingsRook = m_position.castlingRook(army, KingSide);
+        int queensRook = m_position.castlingRook(army, QueenSide);
+        m_rules->setCastleAvailable(army, KingSide, kingsRook >= 0);
+        m_rules->setCastleAvailable(army, QueenSide, queensRook >= 0);
+        if (kingsRook >= 0)
+            m_fileOfKingsRook = kingsRook % 8;
+        if (queensRook >= 0)
+            m_fileOfQueensRook = queensRook % 8;
     }
 
-    QString ranks = rankList.join("/");
-    QString activeArmy = (m_activeArmy == White ? QLatin1String("w") : QLatin1String("b"));
-
-    QString castling;
-    if (m_rules->isCastleAvailable(White, KingSide))
-        isChess960() ? castling.append(Notation::fileToChar(m_fileOfKingsRook).toUpper()) : castling.append("K");
-    if (m_rules->isCastleAvailable(White, QueenSide))
-        isChess960() ? castling.append(Notation::fileToChar(m_fileOfQueensRook).toUpper()) : castling.append("Q");
-    if (m_rules->isCastleAvailable(Black, KingSide))
-        isChess960() ? castling.append(Notation::fileToChar(m_fileOfKingsRook)) : castling.append("k");
-    if (m_rules->isCastleAvailable(Black, QueenSide))
-        isChess960() ? castling.append(Notation::fileToChar(m_fileOfQueensRook)) : castling.append("q");
-    if (castling.isEmpty())
-        castling.append("-");
-
-    QString enPassant = enPassantTarget().isValid() ? Notation::squareToString(enPassantTarget()) : QLatin1String("-");
-
-    QStringList fen;
-    fen << ranks << activeArmy << castling << enPassant << QString::number(halfMoveClock()) << QString::number(fullMoveNumber());
-
-    return fen.join(" ");
+    emit piecesChanged();
 }
@@ -4,14 +4,14 @@
 #include <QObject>
 
 #include <QList>
-#include <QMap>
-#include <QHash>
+#include <QVector>
 #include <QPointer>
 
+#include "fen.h"
 #include "chess.h"
-#include "move.h"
 #include "piece.h"
 #include "square.h"
+#include "position.h"
 
 class Rules;
 class Clock;
@@ -29,7 +29,9 @@ public:
         StaleMate,
         Resignation,
         DrawAccepted,
-        HalfMoveClock
+        HalfMoveClock,
+        Repetition,
+        InsufficientMaterial
     };
     enum Result
     {
@@ -48,7 +50,15 @@ public:
 
     QString fen(int index) const;
 
-    Chess::Army activeArmy() const { return m_activeArmy; }
+    //a FEN the game was created with that did not parse, the game then starts from the usual position
+    Fen::Error fenError() const { return m_fenError; }
+    int fenErrorOffset() const { return m_fenErrorOffset; }
+
+    const Position &currentPosition() const { return m_position; }
+    quint64 key() const { return m_position.key(); }
+    bool isRepetition(int times = 3) const;
+
+    Chess::Army activeArmy() const { return m_position.activeArmy(); }
 
     bool isChess960() const { return m_isChess960; }
     void setChess960(bool isChess960) { m_isChess960 = isChess960; }
@@ -56,17 +66,17 @@ public:
     bool isScratchGame() const { return m_isScratchGame; }
     void setScratchGame(bool isScratchGame);
 
-    PieceList pieces(Chess::Army army) const;
+    PieceRange pieces(Chess::Army army) const { return m_position.pieceRange(army); }
     PieceList capturedPieces(Chess::Army army) const;
 
-    int halfMoveClock() const { return m_halfMoveClock; }
-    void setHalfMoveClock(int halfMoveClock) { m_halfMoveClock = halfMoveClock; }
+    int halfMoveClock() const { return m_position.halfMoveClock(); }
+    void setHalfMoveClock(int halfMoveClock) { m_position.setHalfMoveClock(halfMoveClock); }
 
-    int fullMoveNumber() const { return m_fullMoveNumber; }
-    void setFullMoveNumber(int fullMoveNumber) { m_fullMoveNumber = fullMoveNumber; }
+    int fullMoveNumber() const { return m_position.fullMoveNumber(); }
+    void setFullMoveNumber(int fullMoveNumber) { m_position.setFullMoveNumber(fullMoveNumber); }
 
-    Square enPassantTarget() const { return m_enPassantTarget; }
-    void setEnPassantTarget(Square enPassantTarget) { m_enPassantTarget = enPassantTarget; }
+    Square enPassantTarget() const;
+    void setEnPassantTarget(Square enPassantTarget);
 
     Player *player(Chess::Army army) const;
     void setPlayers(Player *white, Player *black);
@@ -78,8 +88,8 @@ public:
     Ending ending() const { return m_ending; }
     Result result() const { return m_result; }
 
-    bool localHumanMadeMove(Chess::Army army, Move move);
-    bool remoteOrEngineMadeMove(Chess::Army army, Move move);
+    bool localHumanMadeMove(Chess::Army army, PackedMove move);
+    bool remoteOrEngineMadeMove(Chess::Army army, PackedMove move);
 
     int fileOfKingsRook() const { return m_fileOfKingsRook; }
     int fileOfQueensRook() const { return m_fileOfQueensRook; }
@@ -98,31 +108,30 @@ Q_SIGNALS:
 
 private Q_SLOTS:
     void playerReady();
-    void playerMadeMove(Move move);
+    void playerMadeMove(PackedMove move);
 
 private:
-    void processMove(Chess::Army army, Move move);
-    bool fillOutMove(Chess::Army army, Move *move);
-    bool fillOutStart(Chess::Army army, Move *move);
+    void processMove(Chess::Army army, PackedMove move);
+    bool fillOutMove(Chess::Army army, PackedMove *move);
+    void recordKey();
+    void refreshKeyHistory();
 
-    void setFen(const QString &fen);
-    QString stateOfGameToFen() const; /* generates the fen for our current state */
+    Fen::Error setFen(const QString &fen, int *errorOffset);
+    void setCurrentPosition(const Position &position);
 
 private:
+    enum { KeyHistorySize = 128 }; //a power of two longer than the fifty move rule
+
     int m_index;
-    Chess::Army m_activeArmy;
     bool m_isChess960;
     bool m_isScratchGame;
-    int m_halfMoveClock;
-    int m_fullMoveNumber;
     int m_fileOfKingsRook;
     int m_fileOfQueensRook;
-    Square m_enPassantTarget;
-    QHash<int, Piece> m_whitePieces;    //current white pieces
-    QHash<int, Piece> m_blackPieces;    //current black pieces
+    Position m_position;                //current position
     PieceList m_whiteCapturedPieces;    //white pieces that have been captured
     PieceList m_blackCapturedPieces;    //black pieces that have been captured
-    QMap<int, QString> m_mapOfFen;      //map of fen throughout game...
+    QVector<Position> m_history;        //every position of the game, fen is only made on request
+    quint64 m_keyHistory[KeyHistorySize]; //ring of position keys by index, see isRepetition()
     QPointer<Player> m_white;
     QPointer<Player> m_black;
     Rules *m_rules;
@@ -130,6 +139,8 @@ private:
     MovesModel *m_moves;
     Ending m_ending;
     Result m_result;
+    Fen::Error m_fenError;
+    int m_fenErrorOffset;
     friend class Board;
 };
 
@@ -6,8 +6,10 @@
 #include <QCloseEvent>
 #include <QFileDialog>
 #include <QInputDialog>
+#include <QMessageBox>
 #include <QProgressBar>
 
+#include "fen.h"
 #include "pgn.h"
 #include "game.h"
 #include "clock.h"
@@ -56,13 +58,15 @@ MainWindow::MainWindow(QWidget *parent)
 
     m_pgnLoader = new DataLoader(this);
     connect(m_pgnLoader, SIGNAL(progress(qint64, qint64)), this, SLOT(pgnDataProgress(qint64, qint64)));
-    connect(m_pgnLoader, SIGNAL(finished(const QByteArray &)), this, SLOT(pgnDataLoaded(const QByteArray &)));
+    connect(m_pgnLoader, SIGNAL(finished(const char *, qint64)), this, SLOT(pgnDataLoaded(const char *, qint64)));
     connect(m_pgnLoader, SIGNAL(error(const QString &)), this, SLOT(pgnDataError(const QString &)));
 
     m_pgnParser = new PgnParser(this);
     connect(m_pgnParser, SIGNAL(progress(qint64, qint64)), this, SLOT(pgnParserProgress(qint64, qint64)));
     connect(m_pgnParser, SIGNAL(finished(const PgnList &)), this, SLOT(pgnParserFinished(const PgnList &)));
     connect(m_pgnParser, SIGNAL(error(const QString &)), this, SLOT(pgnParserError(const QString &)));
+    //the parser reads the loader's data in place, so it is only let go once the thread is done
+    connect(m_pgnParser, SIGNAL(finished()), m_pgnLoader, SLOT(release()));
 
     newScratchBoard();
 
@@ -82,6 +86,8 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    //the loader is destroyed first and takes the data the parser reads with it
+    m_pgnParser->wait();
 }
 
 void MainWindow::newGame()
@@ -115,11 +121,18 @@ void MainWindow::loadGameFromFEN()
     if (!ok)
         return;
 
-    if (fen.isEmpty())
-        qDebug() << "ERROR! FEN string is empty" << endl;
+    //checked up front so a bad string is reported before the new game dialog, an empty one included
+    QByteArray latin1 = fen.trimmed().toLatin1();
+    Position position;
+    int offset = 0;
+    Fen::Error error = Fen::parse(latin1.constData(), latin1.size(), &position, &offset);
+    if (error != Fen::NoError) {
+        QMessageBox::warning(this, tr("Load FEN String"),
+                             tr("%1\nThe problem is at character %2.").arg(Fen::errorString(error)).arg(offset + 1));
+        return;
+    }
 
-    //FIXME error checking...
-    loadGameFromFEN(fen);
+    loadGameFromFEN(QString::fromLatin1(latin1));
 }
 
 void MainWindow::loadGameFromFEN(const QString &fen)
@@ -146,6 +159,14 @@ void MainWindow::loadGameFromFEN(const QString &fen)
         game->setChess960(true);
     }
 
+    if (game->fenError() != Fen::NoError) {
+        QMessageBox::warning(this, tr("New Game"),
+                             tr("%1\nThe problem is at character %2.").arg(Fen::errorString(game->fenError()))
+                                                                       .arg(game->fenErrorOffset() + 1));
+        delete game;
+        return;
+    }
+
     connect(game, SIGNAL(gameStarted()), this, SLOT(gameStateChanged()));
     connect(game, SIGNAL(gameEnded()), this, SLOT(gameStateChanged()));
 
@@ -360,9 +381,9 @@ void MainWindow::pgnDataProgress(qint64 bytesReceived, qint64 bytesTotal)
     Q_UNUSED(bytesTotal);
 }
 
-void MainWindow::pgnDataLoaded(const QByteArray &data)
+void MainWindow::pgnDataLoaded(const char *data, qint64 size)
 {
-    m_pgnParser->parsePgn(data);
+    m_pgnParser->parsePgn(data, size);
 }
 
 void MainWindow::pgnDataError(const QString &error)
@@ -383,7 +404,13 @@ void MainWindow::pgnParserFinished(const PgnList &games)
     QList<Game*> createdGames;
     foreach (Pgn pgn, games) {
         qDebug() << "generating game" << pgn.tag("White") << "VS" << pgn.tag("Black") << endl;
-        Game *game = new Game(this);
+        QString fen = pgn.tag("FEN");
+        Game *game = fen.isEmpty() ? new Game(this) : new Game(this, fen);
+        if (game->fenError() != Fen::NoError) {
+            pgnParserError(QString("Could not set up the FEN tag '%1': %2").arg(fen).arg(Fen::errorString(game->fenError())));
+            delete game;
+            continue;
+        }
 
         Player *whitePlayer = new Player(game);
         whitePlayer->setPlayerName(pgn.tag("White"));
@@ -397,8 +424,8 @@ void MainWindow::pgnParserFinished(const PgnList &games)
         connect(game, SIGNAL(gameEnded()), this, SLOT(gameStateChanged()));
 
         Chess::Army army = White;
-        QList<Move> moves = pgn.moves();
-        foreach (Move move, moves) {
+        QVector<PackedMove> moves = pgn.moves();
+        foreach (PackedMove move, moves) {
 //             qDebug() << "make move" << Notation::moveToString(move) << endl;
             game->localHumanMadeMove(army, move);
             army = army == White ? Black : White;
@@ -416,7 +443,7 @@ void MainWindow::pgnParserFinished(const PgnList &games)
         createdGames << game;
     }
 
-    int index;
+    int index = ui_tabWidget->currentIndex();
     foreach (Game *game, createdGames) {
         GameView *gameView = new GameView(ui_tabWidget, game);
         game->setParent(gameView); //reparent!!
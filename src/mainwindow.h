@@ -46,7 +46,7 @@ private Q_SLOTS:
     void gameStateChanged();
     void tabChanged(int index);
     void pgnDataProgress(qint64 bytesReceived, qint64 bytesTotal);
-    void pgnDataLoaded(const QByteArray &data);
+    void pgnDataLoaded(const char *data, qint64 size);
     void pgnDataError(const QString &error);
     void pgnParserProgress(qint64 bytesReceived, qint64 bytesTotal);
     void pgnParserFinished(const PgnList &games);
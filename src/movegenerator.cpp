@@ -0,0 +1,296 @@
+#include "movegenerator.h"
+
+#include "attacktable.h"
+
+using namespace Chess;
+
+static inline Army enemyOf(Army army)
+{
+    return army == White ? Black : White;
+}
+
+void MoveGenerator::generateLegalMoves(const Position &position, MoveBuffer &moves)
+{
+    generate(position, moves, AllMoves);
+}
+
+void MoveGenerator::generateCaptures(const Position &position, MoveBuffer &moves)
+{
+    generate(position, moves, Captures);
+}
+
+void MoveGenerator::generateQuietMoves(const Position &position, MoveBuffer &moves)
+{
+    generate(position, moves, QuietMoves);
+}
+
+/*
+ * Only the pieces of one type that reach one square, which is all a move in
+ * notation can be.  Finding them backwards from the square leaves so few
+ * that each is simply tried on a copy.  Castling is never included.
+ */
+void MoveGenerator::generateLegalMovesTo(const Position &position, MoveBuffer &moves, PieceType piece, int to)
+{
+    Army army = position.activeArmy();
+    Army enemy = enemyOf(army);
+    BitBoard ours = position.pieces(army);
+    BitBoard occupied = position.occupied();
+    if (ours.testBit(to) || position.kingSquare(army) < 0)
+        return;
+
+    BitBoard from;
+    int enPassant = position.enPassantSquare();
+    switch (piece) {
+    case King: from = AttackTable::king(to); break;
+    case Queen: from = AttackTable::bishop(to, occupied) | AttackTable::rook(to, occupied); break;
+    case Rook: from = AttackTable::rook(to, occupied); break;
+    case Bishop: from = AttackTable::bishop(to, occupied); break;
+    case Knight: from = AttackTable::knight(to); break;
+    case Pawn:
+        {
+            if (occupied.testBit(to) || to == enPassant) {
+                from = AttackTable::pawnAttacks(enemy, to);
+            } else {
+                int behind = army == White ? to - 8 : to + 8;
+                int doubleRank = army == White ? 3 : 4;
+                if (behind >= 0 && behind < 64 && occupied.testBit(behind))
+                    from = BitBoard::fromBit(behind);
+                else if (to / 8 == doubleRank)
+                    from = BitBoard::fromBit(army == White ? behind - 8 : behind + 8);
+            }
+            break;
+        }
+    default:
+        return;
+    }
+    from &= position.pieces(army, piece);
+
+    int king = position.kingSquare(army);
+    while (!from.isClear()) {
+        int square = from.takeFirst();
+        PackedMove move(square, to);
+        if (piece == Pawn && to == enPassant)
+            move = PackedMove(square, to, PackedMove::EnPassant);
+        else if (piece == Pawn && (to >= 56 || to < 8))
+            move = PackedMove(square, to, PackedMove::Promotion, Queen);
+
+        Position after(position);
+        after.makeMove(move);
+        int kingAfter = piece == King ? to : king;
+        if (!(after.attackersTo(kingAfter, after.occupied()) & after.pieces(enemy)).isClear())
+            continue;
+
+        if (move.type() == PackedMove::Promotion)
+            appendPawnMoves(moves, square, BitBoard::fromBit(to));
+        else
+            moves.append(move);
+    }
+}
+
+bool MoveGenerator::isLegalMove(const Position &position, PackedMove move)
+{
+    MoveBuffer moves;
+    generate(position, moves, AllMoves);
+    return moves.contains(move);
+}
+
+bool MoveGenerator::isCheckMate(const Position &position)
+{
+    MoveBuffer moves;
+    generate(position, moves, AllMoves);
+    return moves.isEmpty() && position.isChecked();
+}
+
+bool MoveGenerator::isStaleMate(const Position &position)
+{
+    MoveBuffer moves;
+    generate(position, moves, AllMoves);
+    return moves.isEmpty() && !position.isChecked();
+}
+
+BitBoard MoveGenerator::pinnedPieces(const Position &position, Army army)
+{
+    int king = position.kingSquare(army);
+    if (king < 0)
+        return BitBoard();
+
+    Army enemy = enemyOf(army);
+    BitBoard rooks = position.pieces(enemy, Rook) | position.pieces(enemy, Queen);
+    BitBoard bishops = position.pieces(enemy, Bishop) | position.pieces(enemy, Queen);
+    BitBoard snipers = (AttackTable::rook(king, BitBoard()) & rooks)
+                     | (AttackTable::bishop(king, BitBoard()) & bishops);
+    BitBoard occupied = position.occupied();
+
+    //a sniper pins whatever stands alone between it and the king
+    BitBoard pinned;
+    while (!snipers.isClear()) {
+        BitBoard blockers = AttackTable::between(king, snipers.takeFirst()) & occupied;
+        if (!blockers.isClear() && !blockers.hasMoreThanOne())
+            pinned |= blockers & position.pieces(army);
+    }
+    return pinned;
+}
+
+void MoveGenerator::generate(const Position &position, MoveBuffer &moves, int kinds)
+{
+    Army army = position.activeArmy();
+    Army enemy = enemyOf(army);
+    int king = position.kingSquare(army);
+    if (king < 0)
+        return;
+
+    BitBoard ours = position.pieces(army);
+    BitBoard theirs = position.pieces(enemy);
+    BitBoard occupied = ours | theirs;
+
+    BitBoard targetMask;
+    if (kinds & Captures)
+        targetMask |= theirs;
+    if (kinds & QuietMoves)
+        targetMask |= ~occupied;
+
+    //the king may not step onto an attacked square, and must not hide behind itself from a slider
+    BitBoard withoutKing = occupied ^ BitBoard::fromBit(king);
+    BitBoard kingTargets = AttackTable::king(king) & targetMask;
+    while (!kingTargets.isClear()) {
+        int to = kingTargets.takeFirst();
+        if ((position.attackersTo(to, withoutKing) & theirs).isClear())
+            moves.append(PackedMove(king, to));
+    }
+
+    BitBoard checkers = position.attackersTo(king, occupied) & theirs;
+    if (checkers.hasMoreThanOne())
+        return;
+
+    //when in check every other piece has to capture the checker or block it
+    BitBoard checkMask = ~BitBoard();
+    if (!checkers.isClear())
+        checkMask = AttackTable::between(king, checkers.first()) | checkers;
+
+    BitBoard pinned = pinnedPieces(position, army);
+    targetMask &= checkMask;
+
+    BitBoard knights = position.pieces(army, Knight) & ~pinned;
+    while (!knights.isClear()) {
+        int from = knights.takeFirst();
+        appendMoves(moves, from, AttackTable::knight(from) & targetMask);
+    }
+
+    BitBoard bishops = position.pieces(army, Bishop) | position.pieces(army, Queen);
+    while (!bishops.isClear()) {
+        int from = bishops.takeFirst();
+        BitBoard targets = AttackTable::bishop(from, occupied) & targetMask;
+        if (pinned.testBit(from))
+            targets &= AttackTable::line(king, from);
+        appendMoves(moves, from, targets);
+    }
+
+    BitBoard rooks = position.pieces(army, Rook) | position.pieces(army, Queen);
+    while (!rooks.isClear()) {
+        int from = rooks.takeFirst();
+        BitBoard targets = AttackTable::rook(from, occupied) & targetMask;
+        if (pinned.testBit(from))
+            targets &= AttackTable::line(king, from);
+        appendMoves(moves, from, targets);
+    }
+
+    generatePawnMoves(position, moves, kinds, checkMask, pinned);
+
+    if ((kinds & QuietMoves) && checkers.isClear())
+        generateCastles(position, moves);
+}
+
+void MoveGenerator::generatePawnMoves(const Position &position, MoveBuffer &moves, int kinds,
+                                      BitBoard checkMask, BitBoard pinned)
+{
+    Army army = position.activeArmy();
+    Army enemy = enemyOf(army);
+    int king = position.kingSquare(army);
+    BitBoard theirs = position.pieces(enemy);
+    BitBoard occupied = position.occupied();
+
+    int enPassant = position.enPassantSquare();
+    int enPassantVictim = army == White ? enPassant - 8 : enPassant + 8;
+    if (enPassant >= 0 && (!(kinds & Captures) || !position.pieces(enemy, Pawn).testBit(enPassantVictim)))
+        enPassant = -1;
+
+    BitBoard pawns = position.pieces(army, Pawn);
+    while (!pawns.isClear()) {
+        int from = pawns.takeFirst();
+        BitBoard pinMask = pinned.testBit(from) ? AttackTable::line(king, from) : ~BitBoard();
+
+        //promotions count as captures only when they take something
+        BitBoard targets;
+        if (kinds & Captures)
+            targets |= AttackTable::pawnAttacks(army, from) & theirs;
+        if (kinds & QuietMoves)
+            targets |= AttackTable::pawnPushes(army, from, occupied);
+        appendPawnMoves(moves, from, targets & checkMask & pinMask);
+
+        if (enPassant < 0 || !AttackTable::pawnAttacks(army, from).testBit(enPassant))
+            continue;
+
+        //two pawns leave the rank at once so the only safe test is to look again from the king
+        BitBoard after = (occupied ^ BitBoard::fromBit(from) ^ BitBoard::fromBit(enPassantVictim))
+                       | BitBoard::fromBit(enPassant);
+        BitBoard attackers = position.attackersTo(king, after) & theirs & ~BitBoard::fromBit(enPassantVictim);
+        if (attackers.isClear())
+            moves.append(PackedMove(from, enPassant, PackedMove::EnPassant));
+    }
+}
+
+void MoveGenerator::generateCastles(const Position &position, MoveBuffer &moves)
+{
+    Army army = position.activeArmy();
+    Army enemy = enemyOf(army);
+    int king = position.kingSquare(army);
+    BitBoard theirs = position.pieces(enemy);
+    BitBoard occupied = position.occupied();
+    int backRank = army == White ? 0 : 56;
+
+    for (int castle = KingSide; castle <= QueenSide; ++castle) {
+        int rook = position.castlingRook(army, Castle(castle));
+        if (rook < 0)
+            continue;
+
+        int kingTo = backRank + (castle == KingSide ? 6 : 2);
+        if (!(position.castlingPath(army, Castle(castle)) & occupied).isClear())
+            continue;
+
+        BitBoard kingPath = position.castlingKingPath(army, Castle(castle));
+
+        bool isAttacked = false;
+        while (!kingPath.isClear() && !isAttacked)
+            isAttacked = !(position.attackersTo(kingPath.takeFirst(), occupied) & theirs).isClear();
+        if (isAttacked)
+            continue;
+
+        //the castling rook itself may have been shielding the king's destination
+        BitBoard sliders = position.pieces(enemy, Rook) | position.pieces(enemy, Queen);
+        if (!(AttackTable::rook(kingTo, occupied ^ BitBoard::fromBit(rook)) & sliders).isClear())
+            continue;
+
+        moves.append(PackedMove(king, rook, PackedMove::Castling));
+    }
+}
+
+void MoveGenerator::appendMoves(MoveBuffer &moves, int from, BitBoard targets)
+{
+    while (!targets.isClear())
+        moves.append(PackedMove(from, targets.takeFirst()));
+}
+
+void MoveGenerator::appendPawnMoves(MoveBuffer &moves, int from, BitBoard targets)
+{
+    while (!targets.isClear()) {
+        int to = targets.takeFirst();
+        if (to >= 56 || to < 8) {
+            moves.append(PackedMove(from, to, PackedMove::Promotion, Queen));
+            moves.append(PackedMove(from, to, PackedMove::Promotion, Rook));
+            moves.append(PackedMove(from, to, PackedMove::Promotion, Bishop));
+            moves.append(PackedMove(from, to, PackedMove::Promotion, Knight));
+        } else {
+            moves.append(PackedMove(from, to));
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef MOVEGENERATOR_H
+#define MOVEGENERATOR_H
+
+#include "packedmove.h"
+#include "position.h"
+
+/*
+ * Fixed capacity storage for the moves of one position.  No position has
+ * more than 218 legal moves so this never needs to touch the heap.
+ */
+class MoveBuffer {
+public:
+    enum { Capacity = 256 };
+
+    MoveBuffer() : m_count(0) {}
+
+    int count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    void clear() { m_count = 0; }
+
+    PackedMove at(int i) const { Q_ASSERT(i >= 0 && i < m_count); return m_moves[i]; }
+    void append(PackedMove move) { Q_ASSERT(m_count < Capacity); m_moves[m_count++] = move; }
+    bool contains(PackedMove move) const;
+
+    const PackedMove *begin() const { return m_moves; }
+    const PackedMove *end() const { return m_moves + m_count; }
+
+private:
+    PackedMove m_moves[Capacity];
+    int m_count;
+};
+
+inline bool MoveBuffer::contains(PackedMove move) const
+{
+    for (int i = 0; i < m_count; ++i) {
+        if (m_moves[i] == move)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Generates strictly legal moves for the active army.  Checks and pins are
+ * resolved up front into masks so no move ever has to be tried on a copy
+ * of the position and taken back.
+ */
+class MoveGenerator {
+public:
+    static void generateLegalMoves(const Position &position, MoveBuffer &moves);
+    static void generateCaptures(const Position &position, MoveBuffer &moves);
+    static void generateQuietMoves(const Position &position, MoveBuffer &moves);
+    static void generateLegalMovesTo(const Position &position, MoveBuffer &moves, Chess::PieceType piece, int to);
+
+    static bool isLegalMove(const Position &position, PackedMove move);
+    static bool isCheckMate(const Position &position);
+    static bool isStaleMate(const Position &position);
+
+    static BitBoard pinnedPieces(const Position &position, Chess::Army army);
+
+private:
+    enum MoveKind
+    {
+        Captures = 1,
+        QuietMoves = 2,
+        AllMoves = Captures | QuietMoves
+    };
+
+    static void generate(const Position &position, MoveBuffer &moves, int kinds);
+    static void generatePawnMoves(const Position &position, MoveBuffer &moves, int kinds,
+                                  BitBoard checkMask, BitBoard pinned);
+    static void generateCastles(const Position &position, MoveBuffer &moves);
+    static void appendMoves(MoveBuffer &moves, int from, BitBoard targets);
+    static void appendPawnMoves(MoveBuffer &moves, int from, BitBoard targets);
+
+    MoveGenerator();
+    ~MoveGenerator();
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <QPalette>
 #include <QApplication>
 
+#include "rules.h"
 #include "notation.h"
 
 using namespace Chess;
@@ -47,8 +48,8 @@ QVariant MoveItem::data(int role) const
                 result = QString();
             }
 
-            if (m_move.isValid()) {
-                return QString("%1 %2").arg(Notation::moveToString(m_move)).arg(result);
+            if (!m_move.isNull()) {
+                return QString("%1 %2").arg(m_text).arg(result);
             } else if (model()->game()->result() == Game::NoResult) {
                 return QLatin1String("...");
             } else {
@@ -88,23 +89,37 @@ QVariant MoveItem::data(int role) const
 void MoveItem::setData(const QVariant &value, int role)
 {
     if (role == Qt::EditRole) {
-        Move move = Notation::stringToMove(value.toString());
-        if (!move.isValid())
+        Army army = column() == 0 ? White : Black;
+        bool ok;
+        PackedMove move = Notation::stringToMove(model()->game()->rules()->position(army), value.toString(), Standard, &ok);
+        if (!ok)
             return;
 
-        model()->game()->localHumanMadeMove((column() == 0 ? White : Black), move);
+        model()->game()->localHumanMadeMove(army, move);
     }
 }
 
-Move MoveItem::move() const
+PackedMove MoveItem::move() const
 {
     return m_move;
 }
 
-void MoveItem::setMove(Move move)
+MoveAnnotation MoveItem::annotation() const
+{
+    return m_annotation;
+}
+
+QString MoveItem::text() const
+{
+    return m_text;
+}
+
+void MoveItem::setMove(PackedMove move, MoveAnnotation annotation, const QString &text)
 {
     m_move = move;
-    setEditable(!m_move.isValid());
+    m_annotation = annotation;
+    m_text = text;
+    setEditable(m_move.isNull());
 }
 
 MovesModel::MovesModel(Game *game)
@@ -147,10 +162,10 @@ MoveItem *MovesModel::lastMove() const
     return 0;
 }
 
-void MovesModel::addMove(int fullMoveNumber, Chess::Army army, Move move)
+void MovesModel::addMove(int fullMoveNumber, Chess::Army army, PackedMove move, MoveAnnotation annotation, const QString &text)
 {
     MoveItem *moveItem = new MoveItem;
-    moveItem->setMove(move);
+    moveItem->setMove(move, annotation, text);
     setItem(fullMoveNumber - 1, (army == White ? 0 : 1), moveItem);
 
     //create a placeholder...
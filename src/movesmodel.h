@@ -5,7 +5,7 @@
 #include <QStandardItemModel>
 
 #include "game.h"
-#include "move.h"
+#include "packedmove.h"
 #include "chess.h"
 
 class MovesModel;
@@ -22,13 +22,17 @@ public:
     virtual QVariant data(int role = Qt::UserRole + 1) const;
     virtual void setData(const QVariant &value, int role = Qt::UserRole + 1);
 
-    Move move() const;
-    void setMove(Move move);
+    PackedMove move() const;
+    MoveAnnotation annotation() const;
+    QString text() const;
+    void setMove(PackedMove move, MoveAnnotation annotation, const QString &text);
 
     virtual int type() const { return QStandardItem::UserType + 1; }
 
 private:
-    Move m_move;
+    PackedMove m_move;
+    MoveAnnotation m_annotation;
+    QString m_text;     //SAN rendered once when the move is added
 };
 
 class MovesModel : public QStandardItemModel {
@@ -41,7 +45,7 @@ public:
 
     MoveItem *lastMove() const;
 
-    void addMove(int fullMoveNumber, Chess::Army army, Move move);
+    void addMove(int fullMoveNumber, Chess::Army army, PackedMove move, MoveAnnotation annotation, const QString &text);
 
     void clear(int index); //clears everything after index
 
@@ -1,164 +1,476 @@
 #include "notation.h"
 
-#include "move.h"
 #include "square.h"
+#include "position.h"
+#include "movegenerator.h"
 
 #include <QList>
 #include <QDebug>
 
 using namespace Chess;
 
-Move Notation::stringToMove(const QString &string, Chess::NotationType notation, bool *ok, QString *err)
+/* the king's destination, castling is stored as the king taking its own rook */
+static int castleDestination(PackedMove move)
 {
-    //qDebug() << "Notation::stringToMove:" << string << endl;
+    return (move.from() & ~7) + (move.to() > move.from() ? 6 : 2);
+}
+
+/* a king move written as squares may name the castling rook or where the king lands */
+static PackedMove castlingByKingMove(const Position &position, int from, int to)
+{
+    Army army = position.activeArmy();
+    if (from != position.kingSquare(army))
+        return PackedMove();
+
+    for (int castle = KingSide; castle <= QueenSide; ++castle) {
+        int rook = position.castlingRook(army, Castle(castle));
+        if (rook < 0)
+            continue;
+        PackedMove move(from, rook, PackedMove::Castling);
+        if ((to == rook || castleDestination(move) == to) && MoveGenerator::isLegalMove(position, move))
+            return move;
+    }
+    return PackedMove();
+}
+
+/*
+ * Finds the one legal move that fits whatever the notation told us, castle
+ * is -1 unless it is one.  Nothing is guessed: no move or more than one is
+ * reported back through 'matches'.
+ */
+static PackedMove resolveMove(const Position &position, PieceType piece, int from, int fileOfDeparture,
+                              int rankOfDeparture, int to, PieceType promotion, int castle, int *matches)
+{
+    Army army = position.activeArmy();
+    *matches = 0;
+
+    if (castle >= 0) {
+        int rook = position.castlingRook(army, Castle(castle));
+        PackedMove move(position.kingSquare(army), rook, PackedMove::Castling);
+        if (rook < 0 || !MoveGenerator::isLegalMove(position, move))
+            return PackedMove();
+        *matches = 1;
+        return move;
+    }
+
+    if (to < 0)
+        return PackedMove();
+
+    //computer notation only names squares, the piece is whatever stands there
+    if (piece == Unknown && from >= 0 && !position.isEmpty(from) && position.armyAt(from) == army)
+        piece = position.pieceAt(from);
+
+    MoveBuffer moves;
+    MoveGenerator::generateLegalMovesTo(position, moves, piece, to);
+
+    PackedMove result;
+    foreach (PackedMove move, moves) {
+        if (move.promotion() != promotion)
+            continue;
+        if (from != -1 && move.from() != from)
+            continue;
+        if (fileOfDeparture != -1 && move.from() % 8 != fileOfDeparture)
+            continue;
+        if (rankOfDeparture != -1 && move.from() / 8 != rankOfDeparture)
+            continue;
+        result = move;
+        ++*matches;
+    }
+
+    //in Chess960 the castling destination can also be a plain king move, which wins
+    if (*matches == 0 && piece == King && from >= 0) {
+        result = castlingByKingMove(position, from, to);
+        *matches = result.isNull() ? 0 : 1;
+    }
+    return *matches == 1 ? result : PackedMove();
+}
+
+PackedMove Notation::stringToMove(const Position &position, const QString &string, Chess::NotationType notation, bool *ok, QString *err)
+{
+    QByteArray latin1 = string.toLatin1();
+    PackedMove move;
+    Error error = parseMove(position, latin1.constData(), latin1.size(), &move, notation);
     if (ok)
-        *ok = true;
+        *ok = error == NoError;
     if (err)
-        *err = QString();
+        *err = errorString(error, string);
+    return move;
+}
 
-    Move move;
-    switch (notation) {
-    case Standard:
-        {
-            /* Some Examples of SAN moves
-             * d8        //Pawn to d8
-             * cxd8      //Pawn on c captures d8
-             * cxd8=Q+   //Pawn on c captures d8 promotes to queen and check
-             * Qcd8      //Queen on file c to d8
-             * Qc8d8     //Queen on file c and rank 8 to d8
-             * Qxd8      //Queen captures d8
-             * Qcxd8     //Queen on file c captures d8
-             * Qc8xd8    //Queen on file c and rank 8 captures d8
-             * Qc8xd8+   //Queen on file c and rank 8 captures d8 check
-            */
-
-            QString str = string;
-            if (str.contains('x')) {
-                move.setCapture(true);
-                str = str.remove('x');
-            }
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
 
-            if (str.contains('=')) {
-                int i = str.indexOf('=');
-                QChar c = str.at(i + 1);
-                move.setPromotion(charToPiece(c, notation, ok, err));
-                str = str.remove(i + 1, 1);
-                str = str.remove('=');
-            }
+static inline bool isFile(char c)
+{
+    return c >= 'a' && c <= 'h';
+}
 
-            if (str.contains('+')) {
-                move.setCheck(true);
-                str = str.remove('+');
-            }
-            if (str.contains('#')) {
-                move.setCheckMate(true);
-                str = str.remove('#');
-            }
+static inline bool isRank(char c)
+{
+    return c >= '1' && c <= '8';
+}
 
-            if (str == "O-O") {
-                move.setPiece(King);
-                move.setCastle(true);
-                move.setCastleSide(KingSide);
-                break;
-            } else if (str == "O-O-O") {
-                move.setPiece(King);
-                move.setCastle(true);
-                move.setCastleSide(QueenSide);
-                break;
-            } else if (str == "0-1") {
-                break;
-            } else if (str == "1-0") {
-                break;
-            } else if (str == "1/2-1/2") {
-                break;
-            }
+static PieceType letterToPiece(char letter)
+{
+    switch (letter | 0x20) {
+    case 'k': return King;
+    case 'q': return Queen;
+    case 'r': return Rook;
+    case 'b': return Bishop;
+    case 'n': return Knight;
+    case 'p': return Pawn;
+    default: return Unknown;
+    }
+}
 
-            if (str.length() == 2) {
-                move.setPiece(Pawn);
-                move.setEnd(stringToSquare(str.right(2), notation, ok, err));
-            } else if (str.length() == 3) {
-                QChar c = str.at(0);
-                if (c.isUpper()) {
-                    move.setPiece(charToPiece(c, notation, ok, err));
-                } else if (c.isLower()) {
-                    move.setPiece(Pawn);
-                    move.setFileOfDeparture(charToFile(c, notation, ok, err));
-                }
-                move.setEnd(stringToSquare(str.right(2), notation, ok, err));
-            } else if (str.length() == 4) {
-                move.setPiece(charToPiece(str.at(0), notation, ok, err));
-                QChar c = str.at(1);
-                if (c.isLetter() && c.isLower()) {
-                    move.setFileOfDeparture(charToFile(c, notation, ok, err));
-                } else if (c.isNumber()) {
-                    move.setRankOfDeparture(charToRank(c, notation, ok, err));
-                }
-                move.setEnd(stringToSquare(str.right(2), notation, ok, err));
-            } else if (str.length() == 5) {
-                move.setPiece(charToPiece(str.at(0), notation, ok, err));
-                move.setFileOfDeparture(charToFile(str.at(1), notation, ok, err));
-                move.setRankOfDeparture(charToRank(str.at(2), notation, ok, err));
-                move.setEnd(stringToSquare(str.right(2), notation, ok, err));
-            } else {
-                if (ok) *ok = false;
-                if (err) *err = QObject::tr("String for SAN move is incorrect size.");
-            }
-            break;
+static bool isCastling(const char *begin, const char *end, const char *castling)
+{
+    for (; begin < end && *castling; ++begin, ++castling) {
+        if (*begin != *castling && !(*begin == '0' && *castling == 'O'))
+            return false;
+    }
+    return begin == end && !*castling;
+}
+
+/*
+ * One grammar covers all three notations since they only differ in what
+ * they leave out:
+ *
+ *   [piece] [file] [rank] ['x' | '-'] file rank ['=' promotion] [+ # ! ?]
+ *
+ * SAN drops the start square or part of it, long algebraic spells it out
+ * and UCI drops the piece and writes the promotion in lower case.  Castling
+ * may be written with letters or with zeros.
+ */
+Notation::Error Notation::parseMove(const Position &position, const char *data, int length,
+                                    PackedMove *move, Chess::NotationType notation)
+{
+    *move = PackedMove();
+    const char *begin = data;
+    const char *end = data + length;
+
+    //check, mate and annotation glyphs are worked out again when the move is played
+    while (begin < end && isSpace(*begin))
+        ++begin;
+    while (end > begin && (isSpace(end[-1]) || end[-1] == '+' || end[-1] == '#' || end[-1] == '!' || end[-1] == '?'))
+        --end;
+    if (begin == end)
+        return BadSyntax;
+
+    PieceType piece = Unknown;
+    int from = -1;
+    int fileOfDeparture = -1;
+    int rankOfDeparture = -1;
+    int to = -1;
+    PieceType promotion = Unknown;
+    int castle = -1;
+
+    if (isCastling(begin, end, "O-O-O")) {
+        castle = QueenSide;
+    } else if (isCastling(begin, end, "O-O")) {
+        castle = KingSide;
+    } else {
+        if (*begin >= 'A' && *begin <= 'Z') {
+            piece = letterToPiece(*begin++);
+            if (piece == Unknown)
+                return BadPiece;
+        }
+
+        //a destination always ends in a rank, so a trailing letter is the promotion
+        if (end - begin > 2 && (isRank(end[-2]) || end[-2] == '=') &&
+            ((end[-1] >= 'A' && end[-1] <= 'Z') || (end[-1] >= 'a' && end[-1] <= 'z'))) {
+            promotion = letterToPiece(end[-1]);
+            if (promotion == Unknown || promotion == King || promotion == Pawn)
+                return BadPiece;
+            --end;
+            if (end > begin && end[-1] == '=')
+                --end;
         }
-    case Long:
-            move.setCapture(string.contains('x'));
-            move.setPiece(charToPiece(string.at(0), notation, ok, err));
-            move.setStart(move.piece() != Pawn ? stringToSquare(string.mid(1, 2), notation, ok, err) :
-                                                 stringToSquare(string.left(2), notation, ok, err));
-            move.setEnd(stringToSquare(string.right(2), notation, ok, err));
-            break;
-    case Computer:
-        {
-            if (string == QLatin1String("(none)")) //glaurang sends this...
-                break;
 
-            move.setStart(stringToSquare(string.left(2), notation, ok, err));
-            move.setEnd(stringToSquare(string.mid(2, 2), notation, ok, err));
-            if (string.size() == 5) { //promotion
-                move.setPromotion(charToPiece(string.at(4), notation, ok, err));
+        if (end - begin < 2 || !isFile(end[-2]) || !isRank(end[-1]))
+            return BadSquare;
+        to = (end[-1] - '1') * 8 + end[-2] - 'a';
+        end -= 2;
+
+        if (end > begin && (end[-1] == 'x' || end[-1] == '-'))
+            --end;
+
+        if (begin < end && isFile(*begin))
+            fileOfDeparture = *begin++ - 'a';
+        if (begin < end && isRank(*begin))
+            rankOfDeparture = *begin++ - '1';
+        if (begin != end)
+            return BadSyntax;
+
+        if (fileOfDeparture != -1 && rankOfDeparture != -1)
+            from = rankOfDeparture * 8 + fileOfDeparture;
+
+        //only computer notation leaves the piece to be read off the board
+        if (piece == Unknown && (notation != Computer || from < 0))
+            piece = Pawn;
+    }
+
+    int count = 0;
+    *move = resolveMove(position, piece, from, fileOfDeparture, rankOfDeparture, to, promotion, castle, &count);
+    if (count > 1)
+        return AmbiguousMove;
+    return count == 1 ? NoError : IllegalMove;
+}
+
+QString Notation::errorString(Error error, const QString &string)
+{
+    switch (error) {
+    case NoError: return QString();
+    case BadSyntax: return QObject::tr("Move '%1' could not be read.").arg(string);
+    case BadPiece: return QObject::tr("Move '%1' names an unknown piece.").arg(string);
+    case BadSquare: return QObject::tr("Move '%1' has no valid destination square.").arg(string);
+    case IllegalMove: return QObject::tr("Move '%1' is not legal in this position.").arg(string);
+    case AmbiguousMove: return QObject::tr("Move '%1' is ambiguous in this position.").arg(string);
+    default: return QString();
+    }
+}
+
+static const char s_pieceLetters[] = " KQRBNP";
+
+static inline char *writeSquare(char *p, int square)
+{
+    *p++ = char('a' + square % 8);
+    *p++ = char('1' + square / 8);
+    return p;
+}
+
+/*
+ * Writes the move as it is played from 'position', so SAN can name the
+ * start square only as far as another legal move makes it necessary and
+ * can tell check from mate.  Nothing is allocated.
+ */
+int Notation::writeMove(const Position &position, PackedMove move, char *buffer, int size,
+                        Chess::NotationType notation, bool isChess960)
+{
+    Q_ASSERT(size >= MoveBufferSize);
+    if (size < MoveBufferSize || move.isNull())
+        return 0;
+
+    int from = move.from();
+    int to = move.to();
+    PieceType piece = position.pieceAt(from);
+    bool isCastling = move.type() == PackedMove::Castling;
+    bool isCapture = !isCastling && (move.type() == PackedMove::EnPassant || !position.isEmpty(to));
+    if (isCastling && !isChess960)
+        to = castleDestination(move);
+
+    char *p = buffer;
+    if (notation == Computer) {
+        p = writeSquare(p, from);
+        p = writeSquare(p, to);
+        if (move.type() == PackedMove::Promotion)
+            *p++ = char(s_pieceLetters[move.promotion()] | 0x20);
+        *p = '\0';
+        return int(p - buffer);
+    }
+
+    if (isCastling) {
+        const char *castling = move.to() > from ? "O-O" : "O-O-O";
+        while (*castling)
+            *p++ = *castling++;
+    } else if (notation == Long) {
+        if (piece != Pawn)
+            *p++ = s_pieceLetters[piece];
+        p = writeSquare(p, from);
+        *p++ = isCapture ? 'x' : '-';
+        p = writeSquare(p, to);
+    } else {
+        if (piece == Pawn) {
+            if (isCapture)
+                *p++ = char('a' + from % 8);
+        } else {
+            *p++ = s_pieceLetters[piece];
+
+            //name the file, else the rank, else both, whichever tells this piece from the others
+            MoveBuffer rivals;
+            MoveGenerator::generateLegalMovesTo(position, rivals, piece, to);
+            bool isAmbiguous = false;
+            bool sharesFile = false;
+            bool sharesRank = false;
+            foreach (PackedMove rival, rivals) {
+                if (rival.from() == from)
+                    continue;
+                isAmbiguous = true;
+                sharesFile = sharesFile || rival.from() % 8 == from % 8;
+                sharesRank = sharesRank || rival.from() / 8 == from / 8;
             }
+            if (isAmbiguous && (!sharesFile || sharesRank))
+                *p++ = char('a' + from % 8);
+            if (isAmbiguous && sharesFile)
+                *p++ = char('1' + from / 8);
+        }
+        if (isCapture)
+            *p++ = 'x';
+        p = writeSquare(p, to);
+    }
+
+    if (move.type() == PackedMove::Promotion) {
+        *p++ = '=';
+        *p++ = s_pieceLetters[move.promotion()];
+    }
+
+    Position after(position);
+    after.makeMove(move);
+    if (after.isChecked()) {
+        MoveBuffer replies;
+        MoveGenerator::generateLegalMoves(after, replies);
+        *p++ = replies.isEmpty() ? '#' : '+';
+    }
+    *p = '\0';
+    return int(p - buffer);
+}
+
+QString Notation::moveToString(const Position &position, PackedMove move, Chess::NotationType notation, bool isChess960)
+{
+    char buffer[MoveBufferSize];
+    int length = writeMove(position, move, buffer, sizeof(buffer), notation, isChess960);
+    return QString::fromLatin1(buffer, length);
+}
+
+/* the next move in a list, skipping move numbers and results, or 0 at the end */
+static const char *nextMoveToken(const char *p, const char *end, const char **tokenEnd)
+{
+    while (p < end) {
+        while (p < end && isSpace(*p))
+            ++p;
+        const char *start = p;
+        while (p < end && !isSpace(*p))
+            ++p;
+        if (start == p)
             break;
+
+        //"12." and "12..." may also be glued to the move that follows
+        const char *q = start;
+        while (q < p && *q >= '0' && *q <= '9')
+            ++q;
+        if (q > start && q < p && *q == '.') {
+            while (q < p && *q == '.')
+                ++q;
+            start = q;
+            if (start == p)
+                continue;
         }
-    default:
-        break;
+
+        int length = int(p - start);
+        if ((length == 1 && *start == '*') || (length == 3 && !qstrncmp(start, "1-0", 3)) ||
+            (length == 3 && !qstrncmp(start, "0-1", 3)) || (length == 7 && !qstrncmp(start, "1/2-1/2", 7)))
+            continue;
+
+        *tokenEnd = p;
+        return start;
     }
+    return 0;
+}
 
-    return move;
+static void appendMove(const Position &position, PackedMove move, QByteArray *text,
+                       Chess::NotationType notation, bool isChess960)
+{
+    int size = text->size();
+    if (size > 0 && text->at(size - 1) != ' ')
+        text->append(' ');
+    size = text->size();
+    text->resize(size + Notation::MoveBufferSize);
+    int length = Notation::writeMove(position, move, text->data() + size, Notation::MoveBufferSize, notation, isChess960);
+    text->resize(size + length);
+}
+
+Notation::Error Notation::readMoves(Position position, const char *data, int length, QVector<PackedMove> *moves,
+                                    Chess::NotationType notation, int *errorOffset)
+{
+    const char *end = data + length;
+    const char *tokenEnd = 0;
+    for (const char *token = nextMoveToken(data, end, &tokenEnd); token; token = nextMoveToken(tokenEnd, end, &tokenEnd)) {
+        PackedMove move;
+        Error error = parseMove(position, token, int(tokenEnd - token), &move, notation);
+        if (error != NoError) {
+            if (errorOffset)
+                *errorOffset = int(token - data);
+            return error;
+        }
+        moves->append(move);
+        position.makeMove(move);
+    }
+    if (errorOffset)
+        *errorOffset = -1;
+    return NoError;
+}
+
+void Notation::writeMoves(Position position, const PackedMove *moves, int count, QByteArray *text,
+                          Chess::NotationType notation, bool isChess960)
+{
+    for (int i = 0; i < count; ++i) {
+        appendMove(position, moves[i], text, notation, isChess960);
+        position.makeMove(moves[i]);
+    }
+}
+
+Notation::Error Notation::convertMoves(Position position, const char *data, int length, QByteArray *text,
+                                       Chess::NotationType from, Chess::NotationType to,
+                                       bool isChess960, int *errorOffset)
+{
+    const char *end = data + length;
+    const char *tokenEnd = 0;
+    for (const char *token = nextMoveToken(data, end, &tokenEnd); token; token = nextMoveToken(tokenEnd, end, &tokenEnd)) {
+        PackedMove move;
+        Error error = parseMove(position, token, int(tokenEnd - token), &move, from);
+        if (error != NoError) {
+            if (errorOffset)
+                *errorOffset = int(token - data);
+            return error;
+        }
+        appendMove(position, move, text, to, isChess960);
+        position.makeMove(move);
+    }
+    if (errorOffset)
+        *errorOffset = -1;
+    return NoError;
 }
 
-QString Notation::moveToString(Move move, Chess::NotationType notation)
+QString Notation::moveToString(PackedMove move, MoveAnnotation annotation, Chess::NotationType notation, bool isChess960)
 {
     QString str;
 
+    //UCI_Chess960 keeps the king taking its rook, standard chess names where the king lands
+    Square start(move.from() % 8, move.from() / 8);
+    Square end(move.to() % 8, move.to() / 8);
+    if (move.type() == PackedMove::Castling && !isChess960)
+        end = Square(castleDestination(move) % 8, move.from() / 8);
+
     switch (notation) {
     case Standard:
         {
-            QChar piece = pieceToChar(move.piece(), notation);
-            QChar capture = move.isCapture() ? 'x' : QChar();
-            QChar check = move.isCheck() ? '+' : QChar();
-            QChar checkMate = move.isCheckMate() ? '#' : QChar();
-            QString square = squareToString(move.end(), notation);
-
-            if (!piece.isNull()) {
-                str += piece;
-            }
+            QChar piece = pieceToChar(annotation.piece(), notation);
+            QChar capture = annotation.isCapture() ? 'x' : QChar();
+            QChar check = annotation.isCheck() ? '+' : QChar();
+            QChar checkMate = annotation.isCheckMate() ? '#' : QChar();
+            QString square = squareToString(end, notation);
+
+            if (move.type() == PackedMove::Castling) {
+                str = move.to() > move.from() ? "O-O" : "O-O-O";
+            } else {
+                if (!piece.isNull()) {
+                    str += piece;
+                }
 
-            if (!capture.isNull()) {
-                if (move.piece() == Pawn) {
-                    str += fileToChar(move.fileOfDeparture());
+                if (!capture.isNull()) {
+                    if (annotation.piece() == Pawn) {
+                        str += fileToChar(start.file());
+                    }
+                    str += capture;
                 }
-                str += capture;
-            }
 
-            str += square;
+                str += square;
 
-            if (move.promotion() != Unknown) {
-                str += QString("=%1").arg(pieceToChar(move.promotion()));
+                if (move.promotion() != Unknown) {
+                    str += QString("=%1").arg(pieceToChar(move.promotion()));
+                }
             }
 
             if (!checkMate.isNull()) {
@@ -166,36 +478,26 @@ QString Notation::moveToString(Move move, Chess::NotationType notation)
             } else if (!check.isNull()) {
                 str += check;
             }
-
-            if (move.isCastle()) {
-                if (move.isKingSideCastle())
-                    str = "O-O";
-                else if (move.isQueenSideCastle())
-                    str = "O-O-O";
-            }
-
             break;
         }
     case Long:
         {
-            QChar piece = pieceToChar(move.piece(), notation);
-            QChar sep = move.isCapture() ? 'x' : '-';
-            QString start = squareToString(move.start(), notation);
-            QString end = squareToString(move.end(), notation);
+            QChar piece = pieceToChar(annotation.piece(), notation);
+            QChar sep = annotation.isCapture() ? 'x' : '-';
             if (!piece.isNull())
                 str += piece;
 
-            str += start;
+            str += squareToString(start, notation);
             str += sep;
-            str += end;
+            str += squareToString(end, notation);
             break;
         }
     case Computer:
         {
-            QString start = squareToString(move.start(), notation);
-            QString end = squareToString(move.end(), notation);
-            str += start;
-            str += end;
+            str += squareToString(start, notation);
+            str += squareToString(end, notation);
+            if (move.promotion() != Unknown)
+                str += pieceToChar(move.promotion(), notation).toLower();
         break;
         }
     default:
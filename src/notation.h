@@ -2,27 +2,62 @@
 #define NOTATION_H
 
 #include <QString>
+#include <QVector>
+#include <QByteArray>
 
 #include "chess.h"
+#include "packedmove.h"
 
-class Move;
 class Square;
+class Position;
 
 /* TODO
  * Draw offer...
- * Check...
- * CheckMate...
- * Promotion...
- * Castling...
- * En Passant...
- * Disambiguation eg, FileOfDeparture, RankOfDeparture, etc...
- * Error handling and messages
  */
 
 class Notation {
 public:
-    static Move stringToMove(const QString &string, Chess::NotationType notation = Chess::Standard, bool *ok = 0, QString *err = 0);
-    static QString moveToString(Move move, Chess::NotationType notation = Chess::Standard);
+    enum Error
+    {
+        NoError,
+        BadSyntax,
+        BadPiece,
+        BadSquare,
+        IllegalMove,
+        AmbiguousMove
+    };
+
+    /* reads SAN, long algebraic or UCI straight from Latin-1 bytes without allocating */
+    static Error parseMove(const Position &position, const char *data, int length, PackedMove *move,
+                           Chess::NotationType notation = Chess::Standard);
+    static QString errorString(Error error, const QString &string);
+
+    /* enough for the longest move in any notation and a terminating zero */
+    enum { MoveBufferSize = 16 };
+
+    /* 'position' is the one the move is played from, returns the length written */
+    static int writeMove(const Position &position, PackedMove move, char *buffer, int size,
+                         Chess::NotationType notation = Chess::Standard, bool isChess960 = false);
+    static QString moveToString(const Position &position, PackedMove move,
+                                Chess::NotationType notation = Chess::Standard, bool isChess960 = false);
+
+    /*
+     * Whole games at once for batch tools.  One position is replayed in
+     * place and text is appended to the caller's byte array, which keeps its
+     * capacity from game to game.  Nothing is shared, so each worker thread
+     * can convert its own games.  Move numbers and results in the input are
+     * skipped, the output is the moves separated by spaces.
+     */
+    static Error readMoves(Position position, const char *data, int length, QVector<PackedMove> *moves,
+                           Chess::NotationType notation = Chess::Standard, int *errorOffset = 0);
+    static void writeMoves(Position position, const PackedMove *moves, int count, QByteArray *text,
+                           Chess::NotationType notation = Chess::Standard, bool isChess960 = false);
+    static Error convertMoves(Position position, const char *data, int length, QByteArray *text,
+                              Chess::NotationType from, Chess::NotationType to,
+                              bool isChess960 = false, int *errorOffset = 0);
+
+    static PackedMove stringToMove(const Position &position, const QString &string, Chess::NotationType notation = Chess::Standard, bool *ok = 0, QString *err = 0);
+    static QString moveToString(PackedMove move, MoveAnnotation annotation = MoveAnnotation(), Chess::NotationType notation = Chess::Standard, bool isChess960 = false);
 
     static Square stringToSquare(const QString &string, Chess::NotationType notation = Chess::Standard, bool *ok = 0, QString *err = 0);
     static QString squareToString(Square square, Chess::NotationType notation = Chess::Standard);
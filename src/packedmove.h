@@ -0,0 +1,92 @@
+#ifndef PACKEDMOVE_H
+#define PACKEDMOVE_H
+
+#include <QtGlobal>
+
+#include "chess.h"
+
+/*
+ * A move squeezed into 16 bits: six bits for the start square, six for the
+ * end square, two for the promotion piece and two for the kind of move.
+ * Castling is encoded as the king capturing its own rook which works the
+ * same for standard chess and Chess960.
+ */
+class PackedMove {
+public:
+    enum Type
+    {
+        Normal,
+        Promotion,
+        EnPassant,
+        Castling
+    };
+
+    constexpr PackedMove() : m_data(0) {}
+    constexpr PackedMove(int from, int to, Type type = Normal, Chess::PieceType promotion = Chess::Queen)
+        : m_data(quint16(from | (to << 6) | ((promotion - Chess::Queen) << 12) | (type << 14))) {}
+
+    constexpr bool isNull() const { return m_data == 0; }
+
+    constexpr int from() const { return m_data & 0x3f; }
+    constexpr int to() const { return (m_data >> 6) & 0x3f; }
+    constexpr Type type() const { return Type(m_data >> 14); }
+
+    constexpr Chess::PieceType promotion() const
+    { return type() == Promotion ? Chess::PieceType(((m_data >> 12) & 3) + Chess::Queen) : Chess::Unknown; }
+
+    constexpr quint16 data() const { return m_data; }
+    static constexpr PackedMove fromData(quint16 data) { return PackedMove(data, 0); }
+
+    constexpr bool operator==(const PackedMove &other) const { return m_data == other.m_data; }
+    constexpr bool operator!=(const PackedMove &other) const { return m_data != other.m_data; }
+
+private:
+    constexpr PackedMove(quint16 data, int) : m_data(data) {}
+
+    quint16 m_data;
+};
+
+/*
+ * The parts of a played move that only matter for showing it, kept beside
+ * the PackedMove so the move itself stays small enough for move lists and
+ * hash tables.
+ */
+class MoveAnnotation {
+public:
+    enum Flag
+    {
+        Capture = 1,
+        Check = 2,
+        CheckMate = 4,
+        DrawOffered = 8
+    };
+
+    constexpr MoveAnnotation() : m_piece(Chess::Unknown), m_flags(0) {}
+    constexpr MoveAnnotation(Chess::PieceType piece, int flags = 0) : m_piece(quint8(piece)), m_flags(quint8(flags)) {}
+
+    Chess::PieceType piece() const { return Chess::PieceType(m_piece); }
+    void setPiece(Chess::PieceType piece) { m_piece = quint8(piece); }
+
+    bool isCapture() const { return m_flags & Capture; }
+    void setCapture(bool isCapture) { setFlag(Capture, isCapture); }
+
+    bool isCheck() const { return m_flags & Check; }
+    void setCheck(bool isCheck) { setFlag(Check, isCheck); }
+
+    bool isCheckMate() const { return m_flags & CheckMate; }
+    void setCheckMate(bool isCheckMate) { setFlag(CheckMate, isCheckMate); }
+
+    bool isDrawOffered() const { return m_flags & DrawOffered; }
+    void setDrawOffered(bool isDrawOffered) { setFlag(DrawOffered, isDrawOffered); }
+
+private:
+    void setFlag(Flag flag, bool on) { m_flags = quint8(on ? m_flags | flag : m_flags & ~flag); }
+
+    quint8 m_piece;
+    quint8 m_flags;
+};
+
+Q_DECLARE_TYPEINFO(PackedMove, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(MoveAnnotation, Q_PRIMITIVE_TYPE);
+
+#endif
@@ -36,8 +36,8 @@ void Pgn::addMoveNumber(int number)
     Q_UNUSED(number);
 }
 
-void Pgn::addMove(const Move &move)
+void Pgn::addMove(PackedMove move)
 {
 //     qDebug() << "addMove" << Notation::moveToString(move) << endl;
-    m_moves.insert(m_moves.count() + 1, move);
+    m_moves.append(move);
 }
@@ -3,10 +3,11 @@
 
 #include <QMap>
 #include <QString>
+#include <QVector>
 #include <QMetaType>
 
-#include "move.h"
 #include "game.h"
+#include "packedmove.h"
 
 class Pgn {
 public:
@@ -14,18 +15,18 @@ public:
     ~Pgn();
 
     QString tag(const QString &name) const;
-    QList<Move> moves() const { return m_moves.values(); };
+    QVector<PackedMove> moves() const { return m_moves; }
     Game::Result result() const { return m_result; }
 
     void addTag(const QString &name, const QString &value);
     void addMoveNumber(int number);
-    void addMove(const Move &move);
+    void addMove(PackedMove move);
     void addResult(Game::Result result) { m_result = result; }
 
 private:
     QMap<QString, QString> m_tags;
     int m_currentMoveNumber;
-    QMap<int, Move> m_moves;
+    QVector<PackedMove> m_moves;
     Game::Result m_result;
     friend class PgnParser;
 };
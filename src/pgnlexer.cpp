@@ -3,6 +3,7 @@
 #include <QDebug>
 
 #include <ctype.h>
+#include <string.h>
 
 PgnToken::PgnToken()
     : start(0), length(0), type(Unknown)
@@ -114,260 +115,182 @@ QByteArray PgnTokenStream::text()
     }
 }
 
-PgnLexer::PgnLexer(QObject *parent)
-    : QObject(parent)
-{
-}
-
-PgnLexer::~PgnLexer()
-{
-}
-
-PgnTokenStream PgnLexer::lex(const QByteArray &text)
+/* the same as text() but points into the lexed bytes instead of copying them */
+const char *PgnTokenStream::textData(int *length)
 {
-    m_size = text.size();
-    m_tokens.clear();
-
-    QByteArray copy = text;
-    QBuffer stream(&copy, this);
-
-    stream.open(QIODevice::ReadOnly | QIODevice::Text);
-
-    while (!stream.atEnd()) {
-        emit progress(stream.pos(), m_size);
-
-        char s;
-        stream.peek(&s, sizeof(s));
-        if (isspace(s)) {
-            stream.seek(stream.pos() + sizeof(s));
-            continue;
-        }
-
-        if (stream.atEnd())
-            break;
-
-        char c;
-        stream.getChar(&c);
-        if (c == '"')
-            scanString(&stream);
-        else if (c == '.')
-            scanPeriod(&stream);
-        else if (c == '*')
-            scanAsterisk(&stream);
-        else if (c == '[')
-            scanLeftBrack(&stream);
-        else if (c == ']')
-            scanRightBrack(&stream);
-        else if (c == '(')
-            scanLeftParen(&stream);
-        else if (c == ')')
-            scanRightParen(&stream);
-        else if (c == '<')
-            scanLeftAngle(&stream);
-        else if (c == '>')
-            scanRightAngle(&stream);
-        else if (c == '$')
-            scanNAG(&stream);
-        else if (isdigit(c))
-            scanIntegerOrSymbol(&stream, true);
-        else if (isalpha(c))
-            scanIntegerOrSymbol(&stream, false);
-        else
-            qDebug() << "Unknown char:at" << stream.pos() << endl;
-    }
-
-    return PgnTokenStream(text, m_tokens);
-}
-
-void PgnLexer::scanString(QBuffer *stream)
-{
-//     qDebug() << "scanString start pos:" << stream->pos() << endl;
-    PgnToken token;
-    token.start = stream->pos() - 1;
-
-    while (!stream->atEnd() || stream->pos() - token.start == 255) {
-        emit progress(stream->pos(), m_size);
-
-        char s;
-        stream->peek(&s, sizeof(s));
-        if (isspace(s)) {
-            stream->seek(stream->pos() + sizeof(s));
-            continue;
-        }
-
-        if (stream->atEnd()) {
-            break;
-        }
-
-        char c;
-        stream->getChar(&c);
-        if (c == '\\') {
-            stream->seek(stream->pos() + 1);
-        } else if (c == '"') {
-            break;
-        }
+    *length = 0;
+    if (m_pos < 0 || m_pos > m_tokens.count() - 1)
+        return 0;
+
+    const PgnToken &token = m_tokens.at(m_pos);
+    const char *begin = m_text.constData() + token.start;
+    const char *end = begin + token.length;
+    while (begin < end && isspace(uchar(*begin)))
+        ++begin;
+    while (end > begin && isspace(uchar(end[-1])))
+        --end;
+    if (token.type == PgnToken::String && end - begin >= 2) {
+        ++begin;
+        --end;
     }
-
-    token.length = stream->pos() - token.start;
-
-    token.type = PgnToken::String;
-    m_tokens << token;
-//     qDebug() << "scanString end pos:" << stream->pos() << endl;
+    *length = int(end - begin);
+    return begin;
 }
 
-void PgnLexer::scanPeriod(QBuffer *stream)
+/*
+ * What each byte can be in PGN.  Symbols start with a letter or digit and
+ * run on through the characters of SAN and results.  Runs of '!' and '?'
+ * are the move suffix annotations that stand in for NAGs $1 to $6.
+ */
+enum CharClass
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::Period;
-    m_tokens << token;
-}
-
-void PgnLexer::scanAsterisk(QBuffer *stream)
+    Space = 1,
+    Digit = 2,
+    Letter = 4,
+    SymbolTail = 8,
+    Annotation = 16
+};
+
+struct CharClassTable {
+    constexpr CharClassTable();
+    quint8 classes[256];
+};
+
+constexpr CharClassTable::CharClassTable()
+    : classes()
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::Asterisk;
-    m_tokens << token;
+    classes[int(' ')] = classes[int('\t')] = classes[int('\r')] = classes[int('\n')] = Space;
+    classes[int('\v')] = classes[int('\f')] = Space;
+    for (int c = '0'; c <= '9'; ++c)
+        classes[c] = Digit | SymbolTail;
+    for (int c = 'a'; c <= 'z'; ++c)
+        classes[c] = Letter | SymbolTail;
+    for (int c = 'A'; c <= 'Z'; ++c)
+        classes[c] = Letter | SymbolTail;
+    const char tail[] = "_+#=:-/";
+    for (int i = 0; tail[i]; ++i)
+        classes[int(tail[i])] = SymbolTail;
+    classes[int('!')] = classes[int('?')] = Annotation;
 }
 
-void PgnLexer::scanLeftBrack(QBuffer *stream)
-{
-//     qDebug() << "scanLeftBrack start pos:" << stream->pos() << endl;
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::LeftBrack;
-    m_tokens << token;
-//     qDebug() << "scanLeftBrack end pos:" << stream->pos() << endl;
-}
+static constexpr CharClassTable s_charClasses;
 
-void PgnLexer::scanRightBrack(QBuffer *stream)
+static inline int charClass(char c)
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::RightBrack;
-    m_tokens << token;
+    return s_charClasses.classes[uchar(c)];
 }
 
-void PgnLexer::scanLeftParen(QBuffer *stream)
+/* the closing quote of a string that opened just before 'p', or 'end' */
+static const char *skipString(const char *p, const char *end)
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::LeftParen;
-    m_tokens << token;
+    while (p < end) {
+        const char *quote = static_cast<const char*>(memchr(p, '"', end - p));
+        if (!quote)
+            return end;
+
+        //an odd run of backslashes escapes the quote
+        const char *q = quote;
+        while (q > p && q[-1] == '\\')
+            --q;
+        if ((quote - q) % 2 == 0)
+            return quote;
+        p = quote + 1;
+    }
+    return end;
 }
 
-void PgnLexer::scanRightParen(QBuffer *stream)
+/* the first byte of 'c' from 'p' on, or 'end' */
+static inline const char *skipTo(const char *p, const char *end, char c)
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::RightParen;
-    m_tokens << token;
+    const char *found = static_cast<const char*>(memchr(p, c, end - p));
+    return found ? found : end;
 }
 
-void PgnLexer::scanLeftAngle(QBuffer *stream)
+PgnLexer::PgnLexer(QObject *parent)
+    : QObject(parent)
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::LeftAngle;
-    m_tokens << token;
 }
 
-void PgnLexer::scanRightAngle(QBuffer *stream)
+PgnLexer::~PgnLexer()
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
-    token.length = 1;
-    token.type = PgnToken::RightAngle;
-    m_tokens << token;
 }
 
-void PgnLexer::scanNAG(QBuffer *stream)
+PgnTokenStream PgnLexer::lex(const QByteArray &text)
 {
-    PgnToken token;
-    token.start = stream->pos() - 1;
+    m_size = text.size();
+    m_tokens.clear();
 
-    while (!stream->atEnd()) {
-        emit progress(stream->pos(), m_size);
+    const char *begin = text.constData();
+    const char *end = begin + text.size();
+    const char *p = begin;
+    const char *nextProgress = begin;
+    bool atLineStart = true;
 
-        char s;
-        stream->peek(&s, sizeof(s));
-        if (isspace(s)) {
-            stream->seek(stream->pos() + sizeof(s));
-            continue;
+    while (p < end) {
+        if (p >= nextProgress) {
+            emit progress(p - begin, m_size);
+            nextProgress = p + ProgressInterval;
         }
 
-        if (stream->atEnd()) {
-            break;
-        }
-
-        char c;
-        stream->getChar(&c);
-        if (!isdigit(c)) {
-            stream->seek(stream->pos() - 1);
-            break;
+        char c = *p;
+        int type = charClass(c);
+        if (type & Space) {
+            atLineStart = c == '\n';
+            ++p;
+            continue;
         }
-    }
-
-    token.length = stream->pos() - token.start;
-
-    token.type = PgnToken::NAG;
-    m_tokens << token;
-}
-
-void PgnLexer::scanIntegerOrSymbol(QBuffer *stream, bool integer)
-{
-//     qDebug() << "scanIntegerOrSymbol start pos:" << stream->pos() << endl;
-    PgnToken token;
-    token.start = stream->pos() - 1;
 
-    while (!stream->atEnd() || stream->pos() - token.start == 255) {
-        emit progress(stream->pos(), m_size);
-
-        if (stream->atEnd()) {
-            break;
+        //a percent sign in the first column escapes the rest of the line
+        if (c == '%' && atLineStart) {
+            p = skipTo(p, end, '\n');
+            continue;
         }
-
-        char c;
-        stream->getChar(&c);
-        if (c == '_') {
-            integer = false;
-        } else if (c == '+') {
-            integer = false;
-        } else if (c == '#') {
-            integer = false;
-        } else if (c == '=') {
-            integer = false;
-        } else if (c == ':') {
-            integer = false;
-        } else if (c == '-') {
-            integer = false;
-        } else if (c == '/') {
-            integer = false;
-        } else if (isalpha(c)) {
-            integer = false;
-        } else if (isdigit(c)) {
-            ; //do nothing
-        } else {
-            stream->seek(stream->pos() - 1);
+        atLineStart = false;
+
+        const char *start = p++;
+        PgnToken::Type token = PgnToken::Unknown;
+        switch (c) {
+        case '"': p = skipString(p, end); p += p < end; token = PgnToken::String; break;
+        case '.': token = PgnToken::Period; break;
+        case '*': token = PgnToken::Asterisk; break;
+        case '[': token = PgnToken::LeftBrack; break;
+        case ']': token = PgnToken::RightBrack; break;
+        case '(': token = PgnToken::LeftParen; break;
+        case ')': token = PgnToken::RightParen; break;
+        case '<': token = PgnToken::LeftAngle; break;
+        case '>': token = PgnToken::RightAngle; break;
+        case '{': p = skipTo(p, end, '}'); p += p < end; continue; //comments are dropped
+        case ';': p = skipTo(p, end, '\n'); continue;
+        case '$':
+            while (p < end && (charClass(*p) & Digit))
+                ++p;
+            token = PgnToken::NAG;
             break;
+        default:
+            {
+                if (type & Annotation) {
+                    while (p < end && (charClass(*p) & Annotation))
+                        ++p;
+                    token = PgnToken::NAG;
+                    break;
+                }
+
+                //anything else outside of strings and comments means nothing
+                if (!(type & (Digit | Letter)))
+                    continue;
+
+                bool isInteger = type & Digit;
+                while (p < end && (charClass(*p) & SymbolTail)) {
+                    isInteger = isInteger && (charClass(*p) & Digit);
+                    ++p;
+                }
+                token = isInteger ? PgnToken::Integer : PgnToken::Symbol;
+                break;
+            }
         }
+        m_tokens << PgnToken(int(start - begin), int(p - start), token);
     }
 
-    token.length = stream->pos() - token.start;
-
-    if (integer)
-        token.type = PgnToken::Integer;
-    else
-        token.type = PgnToken::Symbol;
-    m_tokens << token;
-
-//     qDebug() << "scanIntegerOrSymbol end pos:" << stream->pos() << endl;
+    emit progress(m_size, m_size);
+    return PgnTokenStream(text, m_tokens);
 }
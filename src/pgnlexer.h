@@ -4,9 +4,8 @@
 #include <QDebug>
 #include <QVector>
 #include <QByteArray>
-#include <QBuffer>
 
-//FIXME Comments!
+//brace, semicolon and percent escape comments are skipped, so no token carries them
 
 class PgnToken
 {
@@ -53,6 +52,7 @@ public:
     PgnToken token();
     PgnToken::Type lookAhead(int pos = 0);
     QByteArray text();
+    const char *textData(int *length);
 
 private:
     int m_pos;
@@ -60,9 +60,16 @@ private:
     QVector<PgnToken> m_tokens;
 };
 
+/*
+ * Walks the bytes directly with a table of character classes.  Strings and
+ * comments are skipped in bulk and progress is only reported every
+ * ProgressInterval bytes.
+ */
 class PgnLexer : public QObject {
     Q_OBJECT
 public:
+    enum { ProgressInterval = 1 << 20 };
+
     PgnLexer(QObject *parent = 0);
     ~PgnLexer();
 
@@ -71,21 +78,6 @@ public:
 Q_SIGNALS:
     void progress(qint64 pos, qint64 size);
 
-private:
-    bool nextToken(PgnToken &tok);
-
-    void scanString(QBuffer *stream);
-    void scanPeriod(QBuffer *stream);
-    void scanAsterisk(QBuffer *stream);
-    void scanLeftBrack(QBuffer *stream);
-    void scanRightBrack(QBuffer *stream);
-    void scanLeftParen(QBuffer *stream);
-    void scanRightParen(QBuffer *stream);
-    void scanLeftAngle(QBuffer *stream);
-    void scanRightAngle(QBuffer *stream);
-    void scanNAG(QBuffer *stream);
-    void scanIntegerOrSymbol(QBuffer *stream, bool integer);
-
 private:
     qint64 m_size;
     QVector<PgnToken> m_tokens;
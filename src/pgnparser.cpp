@@ -8,43 +8,146 @@
 #include "chess.h"
 #include "pgnlexer.h"
 #include "notation.h"
+#include "position.h"
+#include "pgnsplitter.h"
+
+#include <limits.h>
 
 using namespace Chess;
 
 PgnParser::PgnParser(QObject *parent)
-    : QThread(parent)
+    : QThread(parent),
+      m_data(0),
+      m_size(0)
 {
 }
 
 PgnParser::~PgnParser()
 {
+    wait();
 }
 
-void PgnParser::parsePgn(const QByteArray &data)
+void PgnParser::parsePgn(const char *data, qint64 size)
 {
     m_data = data;
+    m_size = size;
     start(); //woohoo!
 }
 
+/*
+ * Parses its share of the chunks found by PgnSplitter.  Each chunk holds
+ * whole games, so it can be lexed and parsed on its own.  The first worker
+ * to fail claims 'failed', leaves its message in 'error' and stops the rest.
+ */
+class PgnWorker : public QThread {
+public:
+    PgnWorker(PgnParser *parser, const QVector<PgnRange> *chunks, QAtomicInt *next,
+              QVector<PgnList> *results, QAtomicInt *failed, QString *error);
+
+protected:
+    void run();
+
+private:
+    void fail(const QString &error);
+
+private:
+    PgnParser *m_parser;
+    const QVector<PgnRange> *m_chunks;
+    QAtomicInt *m_next;
+    QVector<PgnList> *m_results;
+    QAtomicInt *m_failed;
+    QString *m_error;
+};
+
+PgnWorker::PgnWorker(PgnParser *parser, const QVector<PgnRange> *chunks, QAtomicInt *next,
+                     QVector<PgnList> *results, QAtomicInt *failed, QString *error)
+    : m_parser(parser),
+      m_chunks(chunks),
+      m_next(next),
+      m_results(results),
+      m_failed(failed),
+      m_error(error)
+{
+}
+
+void PgnWorker::run()
+{
+    int index;
+    while (!m_failed->fetchAndAddRelaxed(0) && (index = m_next->fetchAndAddRelaxed(1)) < m_chunks->count()) {
+        //only the chunks have to fit in a QByteArray, not the whole file
+        const PgnRange &chunk = m_chunks->at(index);
+        if (chunk.length > INT_MAX) {
+            fail(QString("Game at '%1!' is too large to parse").arg(QString::number(chunk.start)));
+            return;
+        }
+
+        QString error;
+        QByteArray data = QByteArray::fromRawData(m_parser->m_data + chunk.start, int(chunk.length));
+        if (!m_parser->parseGames(data, chunk.start, &(*m_results)[index], &error)) {
+            fail(error);
+            return;
+        }
+    }
+}
+
+void PgnWorker::fail(const QString &error)
+{
+    if (m_failed->testAndSetOrdered(0, 1))
+        *m_error = error;
+}
+
 void PgnParser::run()
 {
     qDebug() << "parsing pgn..." << endl;
-    QList<Pgn> games;
 
+    //split into games first so the lexing and parsing can be shared between threads
+    int threads = qMax(1, QThread::idealThreadCount());
+    QVector<PgnRange> games = PgnSplitter::split(m_data, m_size);
+    QVector<PgnRange> chunks = PgnSplitter::merge(games, threads * 4);
+
+    qDebug() << "split into" << games.count() << "games..." << endl;
+
+    QAtomicInt next(0);
+    QAtomicInt failed(0);
+    QString failure;
+    QVector<PgnList> results(chunks.count());
+    QList<PgnWorker*> workers;
+    for (int i = 0; i < qMin(threads, chunks.count()); ++i) {
+        PgnWorker *worker = new PgnWorker(this, &chunks, &next, &results, &failed, &failure);
+        workers << worker;
+        worker->start();
+    }
+
+    foreach (PgnWorker *worker, workers) {
+        worker->wait();
+        delete worker;
+    }
+    if (failed.fetchAndAddRelaxed(0)) {
+        emit error(failure);
+        return;
+    }
+
+    PgnList parsed;
+    foreach (const PgnList &list, results)
+        parsed += list;
+
+    emit finished(parsed);
+}
+
+bool PgnParser::parseGames(const QByteArray &data, qint64 offset, PgnList *games, QString *error)
+{
     PgnLexer lexer;
     //connect(&lexer, SIGNAL(progress(qint64, qint64)), this, SLOT(lexProgressOut(qint64, qint64)));
     //connect(this, SIGNAL(progress(qint64, qint64)), this, SLOT(parseProgressOut(qint64, qint64)));
-    PgnTokenStream stream = lexer.lex(m_data);
-
-    qDebug() << "lexing finished..." << endl;
+    PgnTokenStream stream = lexer.lex(data);
 
     Pgn pgn;
     while (!stream.atEnd()) {
         switch (stream.lookAhead()) {
         case PgnToken::Unknown:
             {
-                emit error(QString("Unknown token at '%1!'").arg(QString::number(stream.pos())));
-                return;
+                *error = QString("Unknown token at '%1!'").arg(QString::number(offset + stream.token().start));
+                return false;
             }
         case PgnToken::LeftBrack:
             {
@@ -53,20 +156,20 @@ void PgnParser::run()
                     stream.lookAhead(3) == PgnToken::RightBrack) {
 
                     if (!parseTagPair(&stream, &pgn)) {
-                        return;
+                        return false;
                     }
                 } else {
-                    emit error(QString("Could not parse tag pair at '%1!'").arg(QString::number(stream.pos())));
-                    return;
+                    *error = QString("Could not parse tag pair at '%1!'").arg(QString::number(offset + stream.token().start));
+                    return false;
                 }
                 break;
             }
         default:
             {
-                if (!parseMoveText(&stream, &pgn)) {
-                    return;
+                if (!parseMoveText(&stream, &pgn, offset, error)) {
+                    return false;
                 }
-                games << pgn;
+                *games << pgn;
                 pgn = Pgn();
                 break;
             }
@@ -74,9 +177,7 @@ void PgnParser::run()
 
         stream.next();
     }
-
-    emit finished(games);
-    return;
+    return true;
 }
 
 bool PgnParser::parseTagPair(PgnTokenStream *stream, Pgn *pgn)
@@ -95,9 +196,19 @@ bool PgnParser::parseTagPair(PgnTokenStream *stream, Pgn *pgn)
     return true;
 }
 
-bool PgnParser::parseMoveText(PgnTokenStream *stream, Pgn *pgn)
+bool PgnParser::parseMoveText(PgnTokenStream *stream, Pgn *pgn, qint64 offset, QString *error)
 {
-    Q_UNUSED(pgn);
+    //SAN only names the destination, so the game is replayed to find where each move starts
+    QString fen = pgn->tag("FEN");
+    if (fen.isEmpty())
+        fen = QLatin1String("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    bool ok;
+    Position position = Position::fromFen(fen, &ok);
+    if (!ok) {
+        *error = QString("Could not parse FEN tag '%1' at '%2!'").arg(fen).arg(QString::number(offset + stream->token().start));
+        return false;
+    }
 
     while (!stream->atEnd()) {
 //        qDebug() << "token:" << stream->token() << "text:"  << stream->text() << endl;
@@ -105,8 +216,17 @@ bool PgnParser::parseMoveText(PgnTokenStream *stream, Pgn *pgn)
         case PgnToken::Asterisk:
             break; //game termination
         case PgnToken::LeftParen:
+            {
+                //variations are not kept, and replaying them on the main line would make them illegal
+                if (!skipVariation(stream, offset, error))
+                    return false;
+                break;
+            }
         case PgnToken::RightParen:
-            break; //recursive variation
+            {
+                *error = QString("Unbalanced ')' in move text at '%1!'").arg(QString::number(offset + stream->token().start));
+                return false;
+            }
         case PgnToken::LeftAngle:
         case PgnToken::RightAngle:
             break; //reserved for future
@@ -134,8 +254,8 @@ bool PgnParser::parseMoveText(PgnTokenStream *stream, Pgn *pgn)
                 if (text.startsWith('0') || text.startsWith('1')) {
                     pgn->addResult(parseResult(stream->text()));
                 } else {
-                    Move move;
-                    if (!parseMove(stream, &move)) {
+                    PackedMove move;
+                    if (!parseMove(stream, &position, &move, offset, error)) {
                         return false;
                     } else {
                         pgn->addMove(move);
@@ -145,7 +265,7 @@ bool PgnParser::parseMoveText(PgnTokenStream *stream, Pgn *pgn)
             }
         default:
             {
-                emit error(QString("Unknown token in move text at '%1!'").arg(QString::number(stream->pos())));
+                *error = QString("Unknown token in move text at '%1!'").arg(QString::number(offset + stream->token().start));
                 return false;
             }
         }
@@ -157,16 +277,38 @@ bool PgnParser::parseMoveText(PgnTokenStream *stream, Pgn *pgn)
     return true;
 }
 
-bool PgnParser::parseMove(PgnTokenStream *stream, Move *move)
+bool PgnParser::skipVariation(PgnTokenStream *stream, qint64 offset, QString *error)
+{
+    Q_ASSERT(stream->lookAhead() == PgnToken::LeftParen);
+
+    //leaves the stream on the matching ')' so nested variations go with it
+    qint64 start = offset + stream->token().start;
+    int depth = 0;
+    while (!stream->atEnd()) {
+        if (stream->lookAhead() == PgnToken::LeftParen)
+            ++depth;
+        else if (stream->lookAhead() == PgnToken::RightParen && --depth == 0)
+            return true;
+        stream->next();
+    }
+
+    *error = QString("Unclosed variation at '%1!'").arg(QString::number(start));
+    return false;
+}
+
+bool PgnParser::parseMove(PgnTokenStream *stream, Position *position, PackedMove *move, qint64 offset, QString *error)
 {
 //     qDebug() << "token:" << stream->token() << "text:"  << stream->text() << endl;
-    QString err;
-    bool ok = false;
-    *move = Notation::stringToMove(stream->text(), Standard, &ok, &err);
-    if (!err.isEmpty())
-        emit error(err);
-    return ok;
-//    return true;
+    int length;
+    const char *text = stream->textData(&length);
+    Notation::Error result = Notation::parseMove(*position, text, length, move);
+    if (result != Notation::NoError) {
+        *error = QString("Could not parse move at '%1!': %2").arg(QString::number(offset + stream->token().start))
+                                                               .arg(Notation::errorString(result, QString::fromLatin1(text, length)));
+        return false;
+    }
+    position->makeMove(*move);
+    return true;
 }
 
 Game::Result PgnParser::parseResult(const QString &result)
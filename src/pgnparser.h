@@ -6,7 +6,9 @@
 #include "game.h"
 
 class Pgn;
-class Move;
+class Position;
+class PackedMove;
+class PgnWorker;
 class PgnTokenStream;
 typedef QList<Pgn> PgnList;
 
@@ -16,7 +18,8 @@ public:
     PgnParser(QObject *parent);
     ~PgnParser();
 
-    void parsePgn(const QByteArray &data);
+    //the data is not copied and has to outlive the parse
+    void parsePgn(const char *data, qint64 size);
 
 Q_SIGNALS:
     void progress(qint64 bytesReceived, qint64 bytesTotal);
@@ -31,13 +34,19 @@ private Q_SLOTS:
     void parseProgressOut(qint64 bytesReceived, qint64 bytesTotal);
 
 private:
+    friend class PgnWorker;
+    //these run on the worker threads, so errors are handed back rather than emitted
+    //'offset' is where 'data' starts in the file and is added to error positions
+    bool parseGames(const QByteArray &data, qint64 offset, PgnList *games, QString *error);
     bool parseTagPair(PgnTokenStream *stream, Pgn *pgn);
-    bool parseMoveText(PgnTokenStream *stream, Pgn *pgn);
-    bool parseMove(PgnTokenStream *stream, Move *move);
+    bool parseMoveText(PgnTokenStream *stream, Pgn *pgn, qint64 offset, QString *error);
+    bool skipVariation(PgnTokenStream *stream, qint64 offset, QString *error);
+    bool parseMove(PgnTokenStream *stream, Position *position, PackedMove *move, qint64 offset, QString *error);
     Game::Result parseResult(const QString &result);
 
 private:
-    QByteArray m_data;
+    const char *m_data;
+    qint64 m_size;
 };
 
 #endif
@@ -0,0 +1,231 @@
+#include "pgnsplitter.h"
+
+#include <limits.h>
+#include <string.h>
+
+#if defined(Q_PROCESSOR_X86) && (defined(__SSE2__) || defined(Q_PROCESSOR_X86_64) || defined(Q_CC_MSVC))
+#define PGNSPLITTER_SSE2
+#include <emmintrin.h>
+#if defined(Q_CC_GNU) || defined(Q_CC_MSVC)
+#define PGNSPLITTER_AVX2
+#include <immintrin.h>
+#if defined(Q_CC_MSVC)
+#include <intrin.h>
+#endif
+#endif
+#endif
+
+static const char s_event[] = "[Event ";
+static const int s_eventLength = sizeof(s_event) - 1;
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline int lowestBit(unsigned int bits)
+{
+#if defined(Q_CC_MSVC)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return int(index);
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+
+/* the first of 'a', 'b', 'c' or 'd' from 'p' on, or 'end' */
+static const char *findScalar(const char *p, const char *end, char a, char b, char c, char d)
+{
+    for (; p < end; ++p) {
+        char x = *p;
+        if (x == a || x == b || x == c || x == d)
+            return p;
+    }
+    return end;
+}
+
+#if defined(PGNSPLITTER_SSE2)
+static const char *findSse2(const char *p, const char *end, char a, char b, char c, char d)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    const __m128i vd = _mm_set1_epi8(d);
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(x, vc), _mm_cmpeq_epi8(x, vd)));
+        unsigned int mask = unsigned(_mm_movemask_epi8(hits));
+        if (mask)
+            return p + lowestBit(mask);
+    }
+    return findScalar(p, end, a, b, c, d);
+}
+#endif
+
+#if defined(PGNSPLITTER_AVX2)
+/* compiled for AVX2 on its own so the rest of the tree does not need -mavx2 */
+#if defined(Q_CC_GNU)
+__attribute__((target("avx2")))
+#endif
+static const char *findAvx2(const char *p, const char *end, char a, char b, char c, char d)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+    const __m256i vd = _mm256_set1_epi8(d);
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(x, vc), _mm256_cmpeq_epi8(x, vd)));
+        unsigned int mask = unsigned(_mm256_movemask_epi8(hits));
+        if (mask)
+            return p + lowestBit(mask);
+    }
+    return findScalar(p, end, a, b, c, d);
+}
+#endif
+
+static bool processorHasAvx2()
+{
+#if defined(PGNSPLITTER_AVX2) && defined(Q_CC_MSVC)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    //the OS has to save the ymm registers too
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#elif defined(PGNSPLITTER_AVX2)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+typedef const char *(*FindFunction)(const char *, const char *, char, char, char, char);
+
+static FindFunction findFunction()
+{
+#if defined(PGNSPLITTER_AVX2)
+    if (processorHasAvx2())
+        return findAvx2;
+#endif
+#if defined(PGNSPLITTER_SSE2)
+    return findSse2;
+#else
+    return findScalar;
+#endif
+}
+
+/* whether the newline at 'p' ends a blank line */
+static bool endsBlankLine(const char *begin, const char *p)
+{
+    while (p > begin && isBlank(p[-1]))
+        --p;
+    return p == begin || p[-1] == '\n';
+}
+
+static bool isWhitespace(const char *p, const char *end)
+{
+    for (; p < end; ++p) {
+        if (!isBlank(*p) && *p != '\n')
+            return false;
+    }
+    return true;
+}
+
+QVector<PgnRange> PgnSplitter::split(const char *data, qint64 size)
+{
+    static const FindFunction find = findFunction();
+
+    QVector<PgnRange> games;
+    const char *end = data + size;
+    const char *gameStart = data;
+    const char *p = data;
+
+    while (p < end) {
+        //outside of comments and strings only these bytes can change anything
+        p = find(p, end, '\n', '{', '"', ';');
+        if (p == end)
+            break;
+
+        switch (*p) {
+        case '{':
+            {
+                const char *close = static_cast<const char*>(memchr(p + 1, '}', end - p - 1));
+                p = close ? close + 1 : end;
+                break;
+            }
+        case '"':
+            {
+                //strings end at an unescaped quote, the same as in PgnLexer
+                for (++p; p < end; ++p) {
+                    p = find(p, end, '"', '\\', '"', '"');
+                    if (p == end || *p != '\\')
+                        break;
+                    ++p;
+                }
+                if (p < end && *p == '"')
+                    ++p;
+                break;
+            }
+        case ';':
+            {
+                //the newline ending the comment can still end a blank line
+                const char *newline = static_cast<const char*>(memchr(p, '\n', end - p));
+                p = newline ? newline : end;
+                break;
+            }
+        case '\n':
+            {
+                const char *next = p + 1;
+                if (end - next >= s_eventLength && !memcmp(next, s_event, s_eventLength)
+                    && endsBlankLine(data, p) && next > gameStart) {
+                    if (!isWhitespace(gameStart, next)) {
+                        PgnRange range = { gameStart - data, next - gameStart };
+                        games << range;
+                    }
+                    gameStart = next;
+                }
+                p = next;
+                break;
+            }
+        }
+    }
+
+    if (!isWhitespace(gameStart, end)) {
+        PgnRange range = { gameStart - data, end - gameStart };
+        games << range;
+    }
+    return games;
+}
+
+QVector<PgnRange> PgnSplitter::merge(const QVector<PgnRange> &games, int count)
+{
+    QVector<PgnRange> chunks;
+    if (games.isEmpty())
+        return chunks;
+
+    const PgnRange &last = games.last();
+    qint64 total = last.start + last.length - games.first().start;
+    qint64 target = qBound<qint64>(1, total / qMax(1, count), INT_MAX);
+
+    PgnRange chunk = games.first();
+    for (int i = 1; i < games.count(); ++i) {
+        qint64 end = games.at(i).start + games.at(i).length;
+        if (chunk.length >= target || end - chunk.start > INT_MAX) {
+            chunks << chunk;
+            chunk = games.at(i);
+        } else {
+            chunk.length = end - chunk.start;
+        }
+    }
+    chunks << chunk;
+    return chunks;
+}
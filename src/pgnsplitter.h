@@ -0,0 +1,26 @@
+#ifndef PGNSPLITTER_H
+#define PGNSPLITTER_H
+
+#include <QVector>
+
+struct PgnRange {
+    qint64 start;
+    qint64 length;
+};
+
+/*
+ * Finds where each game of a PGN file starts, so the games can be lexed and
+ * parsed independently.  A game starts at an "[Event " tag that follows a
+ * blank line outside of any brace comment or quoted string.  The scan
+ * skips ahead with SSE2 or AVX2 between the few bytes that matter.
+ */
+class PgnSplitter {
+public:
+    static QVector<PgnRange> split(const char *data, qint64 size);
+
+    //merges neighbouring games into about 'count' ranges of similar size,
+    //none of them longer than INT_MAX unless a single game is
+    static QVector<PgnRange> merge(const QVector<PgnRange> &games, int count);
+};
+
+#endif
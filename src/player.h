@@ -6,8 +6,6 @@
 #include "game.h"
 #include "chess.h"
 
-class Move;
-
 class Player : public QObject {
     Q_OBJECT
 public:
@@ -30,7 +28,7 @@ public:
 
 Q_SIGNALS:
     void ready();
-    void madeMove(Move move);
+    void madeMove(PackedMove move);
     void resign();
     void offerDraw();
 
@@ -0,0 +1,396 @@
+#include "position.h"
+
+#include "fen.h"
+#include "attacktable.h"
+
+using namespace Chess;
+
+/* centipawns for the exchange evaluation, the king is worth more than anything it could take */
+static const int s_seeValues[7] = { 0, 10000, 900, 500, 300, 300, 100 };
+
+Position::Position()
+    : m_activeArmy(White),
+      m_enPassantSquare(-1),
+      m_halfMoveClock(0),
+      m_fullMoveNumber(1),
+      m_key(0),
+      m_material(0)
+{
+    for (int square = 0; square < 64; ++square)
+        m_squares[square] = 0;
+    for (int army = 0; army < 2; ++army) {
+        m_castlingRooks[army][KingSide] = -1;
+        m_castlingRooks[army][QueenSide] = -1;
+    }
+}
+
+Position Position::fromFen(const QString &fen, bool *ok)
+{
+    QByteArray latin1 = fen.toLatin1();
+    Position position;
+    Fen::Error error = Fen::parse(latin1.constData(), latin1.size(), &position);
+    if (ok)
+        *ok = error == Fen::NoError;
+    return position;
+}
+
+QString Position::toFen(bool isChess960) const
+{
+    char buffer[Fen::BufferSize];
+    int length = Fen::write(*this, buffer, sizeof(buffer), isChess960);
+    return QString::fromLatin1(buffer, length);
+}
+
+/* four bits per count, enough because Fen never lets an army have more than 16 pieces */
+static inline int materialShift(Army army, PieceType piece)
+{
+    return army * 20 + (piece - Queen) * 4;
+}
+
+static inline quint64 materialUnit(Army army, PieceType piece)
+{
+    return piece >= Queen ? Q_UINT64_C(1) << materialShift(army, piece) : 0;
+}
+
+void Position::addPiece(Army army, PieceType piece, int square)
+{
+    m_armies[army].setBit(square);
+    m_pieces[piece].setBit(square);
+    m_squares[square] = quint8(piece | army << 3);
+    m_key ^= Zobrist::piece(army, piece, square);
+    m_material += materialUnit(army, piece);
+}
+
+void Position::removePiece(Army army, PieceType piece, int square)
+{
+    m_armies[army].clearBit(square);
+    m_pieces[piece].clearBit(square);
+    m_squares[square] = 0;
+    m_key ^= Zobrist::piece(army, piece, square);
+    m_material -= materialUnit(army, piece);
+}
+
+void Position::setActiveArmy(Army army)
+{
+    if (army != m_activeArmy)
+        m_key ^= Zobrist::blackToMove();
+    m_activeArmy = army;
+}
+
+void Position::setCastlingRook(Army army, Castle castle, int square)
+{
+    if (m_castlingRooks[army][castle] >= 0)
+        m_key ^= Zobrist::castling(army, m_castlingRooks[army][castle] % 8);
+    if (square >= 0)
+        m_key ^= Zobrist::castling(army, square % 8);
+    m_castlingRooks[army][castle] = qint8(square);
+
+    int king = kingSquare(army);
+    if (square < 0 || king < 0)
+        return;
+
+    //in Chess960 the king and rook may already stand on or across each other's path
+    int backRank = army == White ? 0 : 56;
+    int kingTo = backRank + (castle == KingSide ? 6 : 2);
+    int rookTo = backRank + (castle == KingSide ? 5 : 3);
+    BitBoard kingPath = AttackTable::between(king, kingTo) | BitBoard::fromBit(kingTo);
+    BitBoard rookPath = AttackTable::between(square, rookTo) | BitBoard::fromBit(rookTo);
+    m_castlingKingPaths[army][castle] = kingPath;
+    m_castlingPaths[army][castle] = (kingPath | rookPath) & ~(BitBoard::fromBit(king) | BitBoard::fromBit(square));
+}
+
+int Position::materialCount(Army army, PieceType piece) const
+{
+    return piece >= Queen ? int(m_material >> materialShift(army, piece) & 15) : 0;
+}
+
+bool Position::isInsufficientMaterial() const
+{
+    //a pawn, rook or queen on either side can always lead to mate
+    static const quint64 mating = Q_UINT64_C(0xf00ff) | Q_UINT64_C(0xf00ff) << 20;
+    if (m_material & mating)
+        return false;
+
+    //a lone minor piece cannot mate, nor can bishops that all stand on one colour
+    int minors = 0;
+    for (int army = White; army <= Black; ++army)
+        minors += materialCount(Army(army), Bishop) + materialCount(Army(army), Knight);
+    if (minors <= 1)
+        return true;
+    if (!m_pieces[Knight].isClear())
+        return false;
+
+    static const BitBoard lightSquares(Q_UINT64_C(0x55aa55aa55aa55aa));
+    return (m_pieces[Bishop] & lightSquares).isClear() || (m_pieces[Bishop] & ~lightSquares).isClear();
+}
+
+int Position::kingSquare(Army army) const
+{
+    BitBoard king = pieces(army, King);
+    return king.isClear() ? -1 : king.first();
+}
+
+quint64 Position::key() const
+{
+    //the en passant file only counts when a pawn could really take, otherwise
+    //every double step would make an identical position look different
+    if (m_enPassantSquare < 0)
+        return m_key;
+    Army enemy = m_activeArmy == White ? Black : White;
+    if ((AttackTable::pawnAttacks(enemy, m_enPassantSquare) & pieces(m_activeArmy, Pawn)).isClear())
+        return m_key;
+    return m_key ^ Zobrist::enPassant(m_enPassantSquare % 8);
+}
+
+BitBoard Position::attackersTo(int square, BitBoard occupied) const
+{
+    //both armies, the caller masks out the one it is interested in
+    return (AttackTable::pawnAttacks(Black, square) & pieces(White, Pawn))
+         | (AttackTable::pawnAttacks(White, square) & pieces(Black, Pawn))
+         | (AttackTable::knight(square) & m_pieces[Knight])
+         | (AttackTable::king(square) & m_pieces[King])
+         | (AttackTable::rook(square, occupied) & (m_pieces[Rook] | m_pieces[Queen]))
+         | (AttackTable::bishop(square, occupied) & (m_pieces[Bishop] | m_pieces[Queen]));
+}
+
+BitBoard Position::checkers() const
+{
+    int king = kingSquare(m_activeArmy);
+    if (king < 0)
+        return BitBoard();
+    Army enemy = m_activeArmy == White ? Black : White;
+    return attackersTo(king, occupied()) & m_armies[enemy];
+}
+
+/*
+ * Takes the cheapest attacker of 'to' for 'army' off the board and lets the
+ * sliders behind it join in.  Returns the piece type, or Unknown when the
+ * army has nothing left that can capture.
+ */
+static PieceType takeLeastValuable(const Position &position, Army army, int to,
+                                   BitBoard *attackers, BitBoard *occupied)
+{
+    BitBoard ours = *attackers & *occupied & position.pieces(army);
+    if (ours.isClear())
+        return Unknown;
+
+    for (int type = Pawn; type >= King; --type) {
+        BitBoard candidates = ours & position.pieces(PieceType(type));
+        if (candidates.isClear())
+            continue;
+
+        occupied->clearBit(candidates.first());
+        if (type == Pawn || type == Bishop || type == Queen)
+            *attackers |= AttackTable::bishop(to, *occupied) & (position.pieces(Bishop) | position.pieces(Queen));
+        if (type == Rook || type == Queen)
+            *attackers |= AttackTable::rook(to, *occupied) & (position.pieces(Rook) | position.pieces(Queen));
+        *attackers &= *occupied;
+        return PieceType(type);
+    }
+    return Unknown;
+}
+
+int Position::see(PackedMove move) const
+{
+    //castling never captures anything
+    if (move.type() == PackedMove::Castling)
+        return 0;
+
+    int from = move.from();
+    int to = move.to();
+    Army army = armyAt(from);
+    BitBoard occupied = this->occupied();
+    occupied.clearBit(from);
+
+    //gain[n] is what the side making capture n ends up with if the exchange stops there
+    int gain[32];
+    int depth = 0;
+    int onSquare = s_seeValues[pieceAt(from)];
+    if (move.type() == PackedMove::EnPassant) {
+        gain[0] = s_seeValues[Pawn];
+        occupied.clearBit(army == White ? to - 8 : to + 8);
+    } else {
+        gain[0] = isEmpty(to) ? 0 : s_seeValues[pieceAt(to)];
+        if (move.type() == PackedMove::Promotion) {
+            gain[0] += s_seeValues[move.promotion()] - s_seeValues[Pawn];
+            onSquare = s_seeValues[move.promotion()];
+        }
+    }
+
+    BitBoard attackers = attackersTo(to, occupied) & occupied;
+    Army side = army;
+    while (depth < 31) {
+        side = side == White ? Black : White;
+        Army enemy = side == White ? Black : White;
+
+        //the king may only take last, when nothing can take it back
+        BitBoard before = occupied;
+        BitBoard beforeAttackers = attackers;
+        PieceType type = takeLeastValuable(*this, side, to, &attackers, &occupied);
+        if (type == Unknown)
+            break;
+        if (type == King && !(attackers & pieces(enemy)).isClear()) {
+            occupied = before;
+            attackers = beforeAttackers;
+            break;
+        }
+
+        ++depth;
+        gain[depth] = onSquare - gain[depth - 1];
+        onSquare = s_seeValues[type];
+    }
+
+    //either side may stop capturing when going on would lose
+    while (depth > 0) {
+        gain[depth - 1] = -qMax(-gain[depth - 1], gain[depth]);
+        --depth;
+    }
+    return gain[0];
+}
+
+bool Position::seeGreaterOrEqual(PackedMove move, int threshold) const
+{
+    //promotions and en passant change the material in ways the quick test does not follow
+    if (move.type() != PackedMove::Normal)
+        return see(move) >= threshold;
+
+    int from = move.from();
+    int to = move.to();
+
+    //'swap' is how far the side to capture next is from turning the result its way
+    int swap = (isEmpty(to) ? 0 : s_seeValues[pieceAt(to)]) - threshold;
+    if (swap < 0)
+        return false;
+    swap = s_seeValues[pieceAt(from)] - swap;
+    if (swap <= 0)
+        return true;
+
+    BitBoard occupied = this->occupied();
+    occupied.clearBit(from);
+    BitBoard attackers = attackersTo(to, occupied) & occupied;
+    Army side = armyAt(from);
+    bool result = true;
+    while (true) {
+        side = side == White ? Black : White;
+        Army enemy = side == White ? Black : White;
+
+        PieceType type = takeLeastValuable(*this, side, to, &attackers, &occupied);
+        if (type == Unknown)
+            break;
+
+        //taking with the king is only possible when nothing can take back
+        if (type == King)
+            return (attackers & pieces(enemy)).isClear() ? !result : result;
+
+        result = !result;
+        swap = s_seeValues[type] - swap;
+        if (swap < int(result))
+            break;
+    }
+    return result;
+}
+
+void Position::makeMove(PackedMove move)
+{
+    SavedState state;
+    makeMove(move, state);
+}
+
+void Position::makeMove(PackedMove move, SavedState &state)
+{
+    for (int side = White; side <= Black; ++side) {
+        state.castlingRooks[side][KingSide] = m_castlingRooks[side][KingSide];
+        state.castlingRooks[side][QueenSide] = m_castlingRooks[side][QueenSide];
+    }
+    state.enPassantSquare = m_enPassantSquare;
+    state.halfMoveClock = m_halfMoveClock;
+    state.key = m_key;
+    state.captured = 0;
+
+    Army army = m_activeArmy;
+    int from = move.from();
+    int to = move.to();
+    PieceType piece = pieceAt(from);
+    m_enPassantSquare = -1;
+    ++m_halfMoveClock;
+
+    if (move.type() == PackedMove::Castling) {
+        //the rook is on 'to' and both pieces land on their standard squares
+        int backRank = army == White ? 0 : 56;
+        bool isKingSide = to > from;
+        removePiece(army, King, from);
+        removePiece(army, Rook, to);
+        addPiece(army, King, backRank + (isKingSide ? 6 : 2));
+        addPiece(army, Rook, backRank + (isKingSide ? 5 : 3));
+    } else {
+        int victim = to;
+        if (move.type() == PackedMove::EnPassant)
+            victim = army == White ? to - 8 : to + 8;
+        if (m_squares[victim]) {
+            state.captured = m_squares[victim];
+            removePiece(armyAt(victim), pieceAt(victim), victim);
+            m_halfMoveClock = 0;
+        }
+
+        removePiece(army, piece, from);
+        addPiece(army, move.type() == PackedMove::Promotion ? move.promotion() : piece, to);
+
+        if (piece == Pawn) {
+            m_halfMoveClock = 0;
+            if (to - from == 16 || from - to == 16)
+                m_enPassantSquare = qint8((from + to) / 2);
+        }
+    }
+
+    for (int side = White; side <= Black; ++side) {
+        for (int castle = KingSide; castle <= QueenSide; ++castle) {
+            int rook = m_castlingRooks[side][castle];
+            if (rook >= 0 && (rook == from || rook == to || (piece == King && side == army)))
+                setCastlingRook(Army(side), Castle(castle), -1);
+        }
+    }
+
+    if (army == Black)
+        ++m_fullMoveNumber;
+    m_activeArmy = army == White ? Black : White;
+    m_key ^= Zobrist::blackToMove();
+}
+
+void Position::unmakeMove(PackedMove move, const SavedState &state)
+{
+    Army army = m_activeArmy == White ? Black : White;
+    int from = move.from();
+    int to = move.to();
+
+    if (move.type() == PackedMove::Castling) {
+        int backRank = army == White ? 0 : 56;
+        bool isKingSide = to > from;
+        removePiece(army, King, backRank + (isKingSide ? 6 : 2));
+        removePiece(army, Rook, backRank + (isKingSide ? 5 : 3));
+        addPiece(army, King, from);
+        addPiece(army, Rook, to);
+    } else {
+        PieceType piece = pieceAt(to);
+        removePiece(army, piece, to);
+        addPiece(army, move.type() == PackedMove::Promotion ? Pawn : piece, from);
+
+        if (state.captured) {
+            int victim = to;
+            if (move.type() == PackedMove::EnPassant)
+                victim = army == White ? to - 8 : to + 8;
+            addPiece(Army(state.captured >> 3 & 1), PieceType(state.captured & 7), victim);
+        }
+    }
+
+    for (int side = White; side <= Black; ++side) {
+        m_castlingRooks[side][KingSide] = state.castlingRooks[side][KingSide];
+        m_castlingRooks[side][QueenSide] = state.castlingRooks[side][QueenSide];
+    }
+    m_enPassantSquare = state.enPassantSquare;
+    m_halfMoveClock = state.halfMoveClock;
+    m_key = state.key;
+
+    if (army == Black)
+        --m_fullMoveNumber;
+    m_activeArmy = army;
+}
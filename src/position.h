@@ -0,0 +1,146 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <QtGlobal>
+#include <QString>
+
+#include "chess.h"
+#include "piece.h"
+#include "bitboard.h"
+#include "packedmove.h"
+#include "zobrist.h"
+
+class Position;
+
+/*
+ * The pieces on a set of squares in square order, read from the mailbox of
+ * a position as they are visited so that listing them never allocates.
+ * The position must outlive the range.
+ */
+class PieceRange {
+public:
+    class Iterator {
+    public:
+        Iterator(const Position *position, BitBoard squares) : m_position(position), m_squares(squares) {}
+
+        Piece operator*() const;
+        Iterator &operator++() { m_squares.takeFirst(); return *this; }
+        bool operator==(const Iterator &other) const { return m_squares == other.m_squares; }
+        bool operator!=(const Iterator &other) const { return m_squares != other.m_squares; }
+
+    private:
+        const Position *m_position;
+        BitBoard m_squares;
+    };
+    typedef Iterator const_iterator;
+
+    PieceRange(const Position *position, BitBoard squares) : m_position(position), m_squares(squares) {}
+
+    Iterator begin() const { return Iterator(m_position, m_squares); }
+    Iterator end() const { return Iterator(m_position, BitBoard()); }
+    int count() const { return m_squares.count(); }
+    bool isEmpty() const { return m_squares.isClear(); }
+
+private:
+    const Position *m_position;
+    BitBoard m_squares;
+};
+
+/*
+ * A chess position as a plain value: bitboards for the generators, a mailbox
+ * for asking what stands on a square, and the rest of the FEN state.
+ * Castling rights are kept as the square of the rook that may still castle,
+ * or -1, so Chess960 starting arrays need no special casing.
+ *
+ * It has no signals and no parent so it can be copied to any thread.
+ */
+class Position {
+public:
+    /* what makeMove() overwrites and unmakeMove() needs back */
+    struct SavedState {
+        qint8 castlingRooks[2][2];
+        qint8 enPassantSquare;
+        quint8 captured;
+        int halfMoveClock;
+        quint64 key;
+    };
+
+    Position();
+
+    static Position fromFen(const QString &fen, bool *ok = 0);
+    QString toFen(bool isChess960 = false) const;
+
+    BitBoard occupied() const { return m_armies[Chess::White] | m_armies[Chess::Black]; }
+    BitBoard pieces(Chess::Army army) const { return m_armies[army]; }
+    BitBoard pieces(Chess::PieceType piece) const { return m_pieces[piece]; }
+    BitBoard pieces(Chess::Army army, Chess::PieceType piece) const { return m_armies[army] & m_pieces[piece]; }
+
+    PieceRange pieceRange(Chess::Army army) const { return PieceRange(this, m_armies[army]); }
+
+    void addPiece(Chess::Army army, Chess::PieceType piece, int square);
+    void removePiece(Chess::Army army, Chess::PieceType piece, int square);
+
+    Chess::PieceType pieceAt(int square) const { return Chess::PieceType(m_squares[square] & 7); }
+    Chess::Army armyAt(int square) const { return Chess::Army(m_squares[square] >> 3 & 1); }
+    bool isEmpty(int square) const { return m_squares[square] == 0; }
+    int kingSquare(Chess::Army army) const;
+
+    Chess::Army activeArmy() const { return m_activeArmy; }
+    void setActiveArmy(Chess::Army army);
+
+    int castlingRook(Chess::Army army, Chess::Castle castle) const { return m_castlingRooks[army][castle]; }
+    void setCastlingRook(Chess::Army army, Chess::Castle castle, int square);
+
+    /* worked out once when the right is set, the king and rook cannot move while it lasts */
+    BitBoard castlingPath(Chess::Army army, Chess::Castle castle) const { return m_castlingPaths[army][castle]; }
+    BitBoard castlingKingPath(Chess::Army army, Chess::Castle castle) const { return m_castlingKingPaths[army][castle]; }
+
+    int enPassantSquare() const { return m_enPassantSquare; }
+    void setEnPassantSquare(int square) { m_enPassantSquare = qint8(square); }
+
+    int halfMoveClock() const { return m_halfMoveClock; }
+    void setHalfMoveClock(int halfMoveClock) { m_halfMoveClock = halfMoveClock; }
+
+    int fullMoveNumber() const { return m_fullMoveNumber; }
+    void setFullMoveNumber(int fullMoveNumber) { m_fullMoveNumber = fullMoveNumber; }
+
+    quint64 key() const;
+
+    /* piece counts four bits each from queens to pawns, white in the low bits, kings left out */
+    quint64 materialKey() const { return m_material; }
+    int materialCount(Chess::Army army, Chess::PieceType piece) const;
+    bool isInsufficientMaterial() const;
+
+    BitBoard attackersTo(int square, BitBoard occupied) const;
+    BitBoard checkers() const;
+    bool isChecked() const { return !checkers().isClear(); }
+
+    int see(PackedMove move) const;
+    bool seeGreaterOrEqual(PackedMove move, int threshold) const;
+
+    void makeMove(PackedMove move);
+    void makeMove(PackedMove move, SavedState &state);
+    void unmakeMove(PackedMove move, const SavedState &state);
+
+private:
+    BitBoard m_armies[2];
+    BitBoard m_pieces[7];
+    quint8 m_squares[64];       //piece type in the low three bits, army above, zero when empty
+    Chess::Army m_activeArmy;
+    qint8 m_castlingRooks[2][2];
+    BitBoard m_castlingPaths[2][2];     //squares other than the king and rook that must be empty
+    BitBoard m_castlingKingPaths[2][2]; //squares the king crosses or lands on, none may be attacked
+    qint8 m_enPassantSquare;
+    int m_halfMoveClock;
+    int m_fullMoveNumber;
+    quint64 m_key;              //pieces, side and castling, en passant is added by key()
+    quint64 m_material;         //see materialKey()
+};
+
+inline Piece PieceRange::Iterator::operator*() const
+{
+    int square = m_squares.first();
+    return Piece(m_position->armyAt(square), m_position->pieceAt(square), BitBoard::bitToSquare(square));
+}
+
+#endif
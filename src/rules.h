@@ -4,11 +4,11 @@
 #include <QObject>
 
 #include "game.h"
+#include "bitboard.h"
+#include "position.h"
 
-class BitBoard;
 
 /* TODO
- * Stalemate rule...
  * Draw rule...
  */
 
@@ -25,49 +25,56 @@ public:
     BitBoard bitBoard(Chess::PieceType piece, Chess::BoardType type = Chess::Positions) const;
     BitBoard bitBoard(Square square, Chess::BoardType type = Chess::Positions) const;
 
-    bool isLegalMove(Chess::Army army, Move move) const;
+    BitBoard attackersTo(Square square) const;
+    BitBoard attackersTo(Square square, BitBoard occupied) const;
+
+    bool isLegalMove(Chess::Army army, PackedMove move) const;
     bool isChecked(Chess::Army army) const;
     bool isCheckMated(Chess::Army army) const;
+    bool isStaleMated(Chess::Army army) const;
     bool isUnderAttack(Piece piece) const;
 
+    /* static exchange evaluation of a capture sequence on the target square, in centipawns */
+    int see(PackedMove move) const;
+    bool seeGreaterOrEqual(PackedMove move, int threshold) const;
+
     bool isCastleLegal(Chess::Army army, Chess::Castle castle) const;
     bool isCastleAvailable(Chess::Army army, Chess::Castle castle) const;
     void setCastleAvailable(Chess::Army army, Chess::Castle castle, bool available);
 
-    Square guessSquare(Chess::Army army, Move move) const;
+    Position position(Chess::Army army) const;
+    quint64 key() const;
 
 private Q_SLOTS:
-    void refreshPositionBoards();
-    void refreshMoveAndAttackBoards();
-    void refreshCastleBoards();
     void refreshBoards();
 
 private:
-    enum Direction { North, NorthEast, East, SouthEast, South, SouthWest, West, NorthWest };
-    SquareList raysForKing(Piece piece);
-    SquareList raysForQueen(Piece piece);
-    SquareList raysForRook(Piece piece);
-    SquareList raysForBishop(Piece piece);
-    SquareList raysForKnight(Piece piece);
-    SquareList raysForPawn(Piece piece);
-    SquareList raysForPawnAttack(Piece piece);
-    void generateRay(Square one, Square two, SquareList *rays) const;
-    void generateRay(Direction direction, int magnitude, Piece piece, SquareList *rays, SquareList *defense) const;
-    bool pieceCanMoveTo(Piece piece, Square square, bool *isCapture) const;
-    bool pieceCanAttackAt(Piece piece, Square square, bool *isCapture) const;
-    bool pieceCanDefendAt(Piece piece, Square square) const;
+    void refreshPositionBoards();
+    void refreshMoveAndAttackBoards(BitBoard changed);
+    void refreshPieceBoards(Piece piece);
+    void refreshCastleBoards();
+    BitBoard occupied() const;
+    BitBoard raysForKing(Piece piece);
+    BitBoard raysForQueen(Piece piece);
+    BitBoard raysForRook(Piece piece);
+    BitBoard raysForBishop(Piece piece);
+    BitBoard raysForKnight(Piece piece);
+    BitBoard raysForPawn(Piece piece);
+    BitBoard raysForPawnAttack(Piece piece);
+    BitBoard raysForAttacks(Piece piece, BitBoard rays, bool isMove = true);
 
 private:
     QHash<Chess::Castle, BitBoard> m_castleBoards;
-    QHash<Chess::Army, BitBoard> m_armyPositionBoards;
-    QHash<Chess::Army, BitBoard> m_armyMoveBoards;
-    QHash<Chess::Army, BitBoard> m_armyAttackBoards;
-    QHash<Chess::PieceType, BitBoard> m_pieceMoveBoards;
-    QHash<Chess::PieceType, BitBoard> m_pieceAttackBoards;
-    QHash<Chess::PieceType, BitBoard> m_piecePositionBoards;
-    QHash<int, BitBoard> m_squareMoves;
-    QHash<int, BitBoard> m_squareAttacks;
-    QHash<int, BitBoard> m_squareDefends;
+    BitBoard m_armyPositionBoards[2];
+    BitBoard m_armyMoveBoards[2];
+    BitBoard m_armyAttackBoards[2];
+    BitBoard m_pieceMoveBoards[7];
+    BitBoard m_pieceAttackBoards[7];
+    BitBoard m_piecePositionBoards[7];
+    BitBoard m_squareMoves[64];
+    BitBoard m_squareAttacks[64];
+    BitBoard m_squareDefends[64];
+    BitBoard m_squareReach[64];     //squares whose contents can change the boards of the piece
 
     bool m_hasWhiteKingCastle;
     bool m_hasBlackKingCastle;
@@ -19,6 +19,7 @@ TARGET = queensmate
 SOURCES += \
     aboutdialog.cpp \
     application.cpp \
+    attacktable.cpp \
     bitboard.cpp \
     board.cpp \
     boardpiece.cpp \
@@ -30,12 +31,13 @@ SOURCES += \
     configuredialog.cpp \
     dataloader.cpp \
     engine.cpp \
+    fen.cpp \
     game.cpp \
     gameview.cpp \
     inlinetableview.cpp \
     main.cpp \
     mainwindow.cpp \
-    move.cpp \
+    movegenerator.cpp \
     movesmodel.cpp \
     newgamedialog.cpp \
     notation.cpp \
@@ -43,7 +45,9 @@ SOURCES += \
     pgn.cpp \
     pgnlexer.cpp \
     pgnparser.cpp \
+    pgnsplitter.cpp \
     player.cpp \
+    position.cpp \
     resource.cpp \
     rules.cpp \
     scratchview.cpp \
@@ -51,11 +55,13 @@ SOURCES += \
     tableview.cpp \
     tabwidget.cpp \
     theme.cpp \
-    uciengine.cpp
+    uciengine.cpp \
+    zobrist.cpp
 
 HEADERS += \
     aboutdialog.h \
     application.h \
+    attacktable.h \
     bitboard.h \
     board.h \
     boardpiece.h \
@@ -68,19 +74,23 @@ HEADERS += \
     configuredialog.h \
     dataloader.h \
     engine.h \
+    fen.h \
     game.h \
     gameview.h \
     inlinetableview.h \
     mainwindow.h \
-    move.h \
+    movegenerator.h \
     movesmodel.h \
     newgamedialog.h \
     notation.h \
+    packedmove.h \
     piece.h \
     pgn.h \
     pgnlexer.h \
     pgnparser.h \
+    pgnsplitter.h \
     player.h \
+    position.h \
     resource.h \
     rules.h \
     scratchview.h \
@@ -88,7 +98,8 @@ HEADERS += \
     tableview.h \
     tabwidget.h \
     theme.h \
-    uciengine.h
+    uciengine.h \
+    zobrist.h
 
 FORMS += \
     ui/aboutdialog.ui \
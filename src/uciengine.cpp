@@ -4,7 +4,6 @@
 #include <QVariant>
 
 #include "chess.h"
-#include "move.h"
 #include "clock.h"
 #include "notation.h"
 
@@ -302,10 +301,10 @@ void UciEngine::parseBestMove(const QByteArray &line)
     QList<QByteArray> bestMove = line.split(' ');
     if (bestMove.count() == 4) {
         emit receivedBestMove(bestMove[1], bestMove[3]);
-        emit madeMove(Notation::stringToMove(bestMove[1], Chess::Computer));
+        emit madeMove(Notation::stringToMove(game()->currentPosition(), bestMove[1], Chess::Computer));
     } else if (bestMove.count() == 2) {
         emit receivedBestMove(bestMove[1], QString());
-        emit madeMove(Notation::stringToMove(bestMove[1], Chess::Computer));
+        emit madeMove(Notation::stringToMove(game()->currentPosition(), bestMove[1], Chess::Computer));
     } else
         parseError(line);
 }
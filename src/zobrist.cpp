@@ -0,0 +1,3 @@
+#include "zobrist.h"
+
+constexpr ZobristTable Zobrist::s_table;
@@ -0,0 +1,63 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <QtGlobal>
+
+#include "chess.h"
+
+/*
+ * Random keys for Zobrist hashing, filled by the compiler from a fixed
+ * seed so every build and every run hashes a position the same way.
+ */
+struct ZobristTable {
+    constexpr ZobristTable();
+
+    quint64 pieces[2][7][64];
+    quint64 castling[2][8];     //by army and file of the castling rook, so Chess960 rights differ
+    quint64 enPassant[8];
+    quint64 blackToMove;
+
+private:
+    static constexpr quint64 next(quint64 &state)
+    {
+        //splitmix64
+        quint64 z = (state += Q_UINT64_C(0x9e3779b97f4a7c15));
+        z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+        return z ^ (z >> 31);
+    }
+};
+
+constexpr ZobristTable::ZobristTable()
+    : pieces(), castling(), enPassant(), blackToMove(0)
+{
+    quint64 state = Q_UINT64_C(0x51756565e5354d61);
+    for (int army = 0; army < 2; ++army) {
+        for (int piece = Chess::King; piece <= Chess::Pawn; ++piece) {
+            for (int square = 0; square < 64; ++square)
+                pieces[army][piece][square] = next(state);
+        }
+        for (int file = 0; file < 8; ++file)
+            castling[army][file] = next(state);
+    }
+    for (int file = 0; file < 8; ++file)
+        enPassant[file] = next(state);
+    blackToMove = next(state);
+}
+
+class Zobrist {
+public:
+    static constexpr quint64 piece(Chess::Army army, Chess::PieceType piece, int square)
+    { return s_table.pieces[army][piece][square]; }
+    static constexpr quint64 castling(Chess::Army army, int file) { return s_table.castling[army][file]; }
+    static constexpr quint64 enPassant(int file) { return s_table.enPassant[file]; }
+    static constexpr quint64 blackToMove() { return s_table.blackToMove; }
+
+private:
+    static constexpr ZobristTable s_table = ZobristTable();
+
+    Zobrist();
+    ~Zobrist();
+};
+
+#endif
@@ -2,7 +2,10 @@
 
 #include <QtTest>
 
-#include "TestObject.h"
+#include "testobject.h"
+#include "testfen.h"
+#include "testpgnparser.h"
+#include "testpgnsplitter.h"
 
 int main(int argc, char *argv[])
 {
@@ -11,5 +14,14 @@ int main(int argc, char *argv[])
     TestObject test1;
     QTest::qExec(&test1, argc, argv);
 
-    return 0;
+    TestPgnSplitter test2;
+    int failures = QTest::qExec(&test2, argc, argv);
+
+    TestPgnParser test3;
+    failures += QTest::qExec(&test3, argc, argv);
+
+    TestFen test4;
+    failures += QTest::qExec(&test4, argc, argv);
+
+    return failures;
 }
@@ -0,0 +1,48 @@
+#include "testfen.h"
+
+#include "fen.h"
+#include "position.h"
+
+static Fen::Error parse(const char *fen, int *errorOffset = 0)
+{
+    Position position;
+    return Fen::parse(fen, int(qstrlen(fen)), &position, errorOffset);
+}
+
+void TestFen::acceptsRealEnPassant()
+{
+    QCOMPARE(parse("4k3/8/8/3Pp3/8/8/8/4K3 w - e6 0 2"), Fen::NoError);
+    QCOMPARE(parse("4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1"), Fen::NoError);
+}
+
+void TestFen::rejectsGhostEnPassant()
+{
+    int offset;
+    //our own pawn in front of the target
+    QCOMPARE(parse("4k3/8/8/3PP3/8/8/8/4K3 w - e6", &offset), Fen::BadEnPassant);
+    QCOMPARE(offset, 27);
+    //no pawn at all
+    QCOMPARE(parse("4k3/8/8/3P4/8/8/8/4K3 w - e6"), Fen::BadEnPassant);
+    //the target square or the square the pawn came from is taken
+    QCOMPARE(parse("4k3/8/4n3/3Pp3/8/8/8/4K3 w - e6"), Fen::BadEnPassant);
+    QCOMPARE(parse("4k3/4n3/8/3Pp3/8/8/8/4K3 w - e6"), Fen::BadEnPassant);
+    QCOMPARE(parse("4k3/8/8/8/3pP3/4N3/8/4K3 b - e3"), Fen::BadEnPassant);
+}
+
+void TestFen::boundsPieceCounts()
+{
+    //nine queens and a king is as much as promotion can give
+    Position position;
+    const char *queens = "QQQQ1k2/QQQQ4/8/8/8/8/8/Q3K3 b - - 0 1";
+    QCOMPARE(Fen::parse(queens, int(qstrlen(queens)), &position), Fen::NoError);
+    QCOMPARE(position.materialCount(Chess::White, Chess::Queen), 9);
+
+    //sixteen pieces fit, the seventeenth does not
+    QCOMPARE(parse("NNNNNk2/NNNNNNNN/8/8/8/8/8/NN1K4 b - - 0 1"), Fen::NoError);
+    int offset;
+    QCOMPARE(parse("NNNNNk2/NNNNNNNN/8/8/8/8/8/NNNK4 b - - 0 1", &offset), Fen::TooManyPieces);
+    QCOMPARE(offset, 30);
+
+    //nine pawns cannot happen
+    QCOMPARE(parse("4k3/8/8/8/8/P7/PPPPPPPP/4K3 w - - 0 1"), Fen::TooManyPieces);
+}
@@ -0,0 +1,16 @@
+#ifndef TESTFEN
+#define TESTFEN
+
+#include <QtTest>
+#include <QObject>
+
+class TestFen : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void acceptsRealEnPassant();
+    void rejectsGhostEnPassant();
+    void boundsPieceCounts();
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "testpgnparser.h"
+
+#include "pgnparser.h"
+
+void TestPgnParser::finished(const PgnList &games)
+{
+    m_games = games;
+    setReceivedResponse(true);
+}
+
+void TestPgnParser::error(const QString &error)
+{
+    m_error = error;
+    setReceivedResponse(true);
+}
+
+void TestPgnParser::parse(const QByteArray &pgn)
+{
+    m_games.clear();
+    m_error.clear();
+    setReceivedResponse(false);
+
+    PgnParser parser(this);
+    connect(&parser, SIGNAL(finished(const PgnList &)), this, SLOT(finished(const PgnList &)));
+    connect(&parser, SIGNAL(error(const QString &)), this, SLOT(error(const QString &)));
+    parser.parsePgn(pgn.constData(), pgn.size());
+    waitForResponse();
+    parser.wait();
+}
+
+void TestPgnParser::skipsVariations()
+{
+    //the variation moves are illegal on the main line
+    parse("[Event \"a\"]\n\n1. e4 (1. d4 d5) 1... e5 (1... c5 2. Nf3) 2. Nf3 Nc6 1-0\n");
+    QVERIFY(m_error.isEmpty());
+    QCOMPARE(m_games.count(), 1);
+    QCOMPARE(m_games.at(0).moves().count(), 4);
+    QCOMPARE(m_games.at(0).result(), Game::WhiteWins);
+}
+
+void TestPgnParser::skipsNestedVariations()
+{
+    parse("[Event \"a\"]\n\n1. e4 e5 (1... c5 2. Nf3 (2. c3 d5 (2... Nf6 3. e5)) 2... d6) 2. Nf3 *\n\n"
+          "[Event \"b\"]\n\n1. d4 (1. c4 (1. Nf3)) d5 *\n");
+    QVERIFY(m_error.isEmpty());
+    QCOMPARE(m_games.count(), 2);
+    QCOMPARE(m_games.at(0).moves().count(), 3);
+    QCOMPARE(m_games.at(1).moves().count(), 2);
+}
+
+void TestPgnParser::rejectsUnbalancedVariations()
+{
+    parse("[Event \"a\"]\n\n1. e4 (1. d4 (1. c4) e5 *\n");
+    QVERIFY(m_error.startsWith("Unclosed variation"));
+
+    parse("[Event \"a\"]\n\n1. e4 e5) 2. Nf3 *\n");
+    QVERIFY(m_error.startsWith("Unbalanced ')'"));
+}
+
+void TestPgnParser::skipsSuffixAnnotations()
+{
+    parse("[Event \"a\"]\n\n1. e4! e5?! 2. Nf3!! !? Nc6 ?? 3. Bb5 1-0\n");
+    QVERIFY(m_error.isEmpty());
+    QCOMPARE(m_games.count(), 1);
+    QCOMPARE(m_games.at(0).moves().count(), 5);
+}
@@ -0,0 +1,29 @@
+#ifndef TESTPGNPARSER
+#define TESTPGNPARSER
+
+#include "testobject.h"
+
+#include "pgn.h"
+
+class TestPgnParser : public TestObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void skipsVariations();
+    void skipsNestedVariations();
+    void rejectsUnbalancedVariations();
+    void skipsSuffixAnnotations();
+
+public Q_SLOTS:
+    void finished(const PgnList &games);
+    void error(const QString &error);
+
+private:
+    void parse(const QByteArray &pgn);
+
+private:
+    PgnList m_games;
+    QString m_error;
+};
+
+#endif
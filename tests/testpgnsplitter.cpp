@@ -0,0 +1,126 @@
+#include "testpgnsplitter.h"
+
+#include "pgnsplitter.h"
+
+static QList<QByteArray> split(const QByteArray &pgn)
+{
+    QList<QByteArray> games;
+    foreach (const PgnRange &range, PgnSplitter::split(pgn.constData(), pgn.size()))
+        games << pgn.mid(int(range.start), int(range.length));
+    return games;
+}
+
+void TestPgnSplitter::splitsAfterBlankLine()
+{
+    QByteArray first("[Event \"a\"]\n\n1. e4 e5 1-0\n\n");
+    QByteArray second("[Event \"b\"]\n\n1. d4 d5 0-1\n");
+    QList<QByteArray> games = split(first + second);
+    QCOMPARE(games.count(), 2);
+    QCOMPARE(games.at(0), first);
+    QCOMPARE(games.at(1), second);
+
+    //a tag on the very next line does not start a game
+    QCOMPARE(split("[Site \"a\"]\n[Event \"b\"]\n\n1. e4 *\n").count(), 1);
+}
+
+void TestPgnSplitter::ignoresEventInBraceComment()
+{
+    QByteArray pgn("[Event \"a\"]\n\n1. e4 {see\n\n[Event \"b\"]\n} e5 1-0\n\n[Event \"c\"]\n\n1. d4 *\n");
+    QList<QByteArray> games = split(pgn);
+    QCOMPARE(games.count(), 2);
+    QVERIFY(games.at(1).startsWith("[Event \"c\"]"));
+}
+
+void TestPgnSplitter::ignoresEventInString()
+{
+    QByteArray pgn("[Event \"a\"]\n[Annotator \"x\n\n[Event \"b\"]\"]\n\n1. e4 *\n\n[Event \"c\"]\n\n1. d4 *\n");
+    QList<QByteArray> games = split(pgn);
+    QCOMPARE(games.count(), 2);
+    QVERIFY(games.at(1).startsWith("[Event \"c\"]"));
+}
+
+void TestPgnSplitter::handlesEscapedQuotes()
+{
+    //neither the escaped quote nor the brace after it ends or opens anything
+    QByteArray pgn("[Event \"a \\\" { \\\\\"]\n\n1. e4 *\n\n[Event \"b\"]\n\n1. d4 *\n");
+    QList<QByteArray> games = split(pgn);
+    QCOMPARE(games.count(), 2);
+    QVERIFY(games.at(1).startsWith("[Event \"b\"]"));
+
+    //but an escaped backslash does not escape the closing quote
+    pgn = "[Event \"a\\\\\"]\n{\n\n[Event \"b\"]\n}\n\n[Event \"c\"]\n\n1. d4 *\n";
+    games = split(pgn);
+    QCOMPARE(games.count(), 2);
+    QVERIFY(games.at(1).startsWith("[Event \"c\"]"));
+}
+
+void TestPgnSplitter::handlesLineComments()
+{
+    QByteArray pgn("[Event \"a\"]\n\n1. e4 ; a { or \" does not open anything\n\n[Event \"b\"]\n\n1. d4 *\n");
+    QList<QByteArray> games = split(pgn);
+    QCOMPARE(games.count(), 2);
+    QVERIFY(games.at(1).startsWith("[Event \"b\"]"));
+}
+
+void TestPgnSplitter::handlesCrLf()
+{
+    QByteArray first("[Event \"a\"]\r\n\r\n1. e4 e5 1-0\r\n\r\n");
+    QByteArray second("[Event \"b\"]\r\n\r\n1. d4 d5 0-1\r\n");
+    QList<QByteArray> games = split(first + second);
+    QCOMPARE(games.count(), 2);
+    QCOMPARE(games.at(0), first);
+    QCOMPARE(games.at(1), second);
+}
+
+void TestPgnSplitter::skipsLeadingWhitespace()
+{
+    QList<QByteArray> games = split("\n \r\n\n[Event \"a\"]\n\n1. e4 *\n");
+    QCOMPARE(games.count(), 1);
+    QVERIFY(games.at(0).startsWith("[Event \"a\"]"));
+
+    QCOMPARE(split(" \n\t\n").count(), 0);
+    QCOMPARE(split(QByteArray()).count(), 0);
+}
+
+void TestPgnSplitter::keepsLastGameWithoutNewline()
+{
+    QByteArray pgn("[Event \"a\"]\n\n1. e4 *\n\n[Event \"b\"]\n\n1. d4 *");
+    QList<QByteArray> games = split(pgn);
+    QCOMPARE(games.count(), 2);
+    QCOMPARE(games.at(1), QByteArray("[Event \"b\"]\n\n1. d4 *"));
+}
+
+void TestPgnSplitter::scansLongInput()
+{
+    //long enough for the vector loops, with every special byte at every alignment
+    QByteArray game("[Event \"x \\\"y\\\" {\"]\n[Site \"?\"]\n\n1. e4 {a\n\n[Event \"z\"]} e5 ; {\n2. Nf3 1-0\n\n");
+    QByteArray pgn;
+    for (int i = 0; i < 100; ++i)
+        pgn += QByteArray(i % 37, ' ') + '\n' + game;
+
+    QList<QByteArray> games = split(pgn);
+    QCOMPARE(games.count(), 100);
+    for (int i = 0; i < 99; ++i)
+        QCOMPARE(games.at(i), game + QByteArray((i + 1) % 37, ' ') + '\n');
+}
+
+void TestPgnSplitter::mergesIntoContiguousChunks()
+{
+    QByteArray pgn;
+    for (int i = 0; i < 50; ++i)
+        pgn += "[Event \"" + QByteArray::number(i) + "\"]\n\n1. e4 *\n\n";
+
+    QVector<PgnRange> games = PgnSplitter::split(pgn.constData(), pgn.size());
+    QCOMPARE(games.count(), 50);
+
+    QVector<PgnRange> chunks = PgnSplitter::merge(games, 8);
+    QVERIFY(chunks.count() >= 8 && chunks.count() <= 9);
+    qint64 end = 0;
+    foreach (const PgnRange &chunk, chunks) {
+        QCOMPARE(chunk.start, end);
+        end = chunk.start + chunk.length;
+    }
+    QCOMPARE(end, qint64(pgn.size()));
+
+    QCOMPARE(PgnSplitter::merge(QVector<PgnRange>(), 8).count(), 0);
+}
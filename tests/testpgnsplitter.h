@@ -0,0 +1,23 @@
+#ifndef TESTPGNSPLITTER
+#define TESTPGNSPLITTER
+
+#include <QtTest>
+#include <QObject>
+
+class TestPgnSplitter : public QObject
+{
+Q_OBJECT
+private Q_SLOTS:
+    void splitsAfterBlankLine();
+    void ignoresEventInBraceComment();
+    void ignoresEventInString();
+    void handlesEscapedQuotes();
+    void handlesLineComments();
+    void handlesCrLf();
+    void skipsLeadingWhitespace();
+    void keepsLastGameWithoutNewline();
+    void scansLongInput();
+    void mergesIntoContiguousChunks();
+};
+
+#endif
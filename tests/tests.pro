@@ -1,4 +1,4 @@
-include($$PWD/../castle.pri)
+include($$PWD/../queensmate.pri)
 
 CONFIG += qtestlib
 TEMPLATE = app
@@ -14,7 +14,26 @@ INCLUDEPATH += \
 
 SOURCES += \
     main.cpp \
-    testobject.cpp \
+    testfen.cpp \
+    testpgnparser.cpp \
+    testpgnsplitter.cpp \
+    $$TOPLEVELDIR/src/attacktable.cpp \
+    $$TOPLEVELDIR/src/bitboard.cpp \
+    $$TOPLEVELDIR/src/fen.cpp \
+    $$TOPLEVELDIR/src/movegenerator.cpp \
+    $$TOPLEVELDIR/src/notation.cpp \
+    $$TOPLEVELDIR/src/pgn.cpp \
+    $$TOPLEVELDIR/src/pgnlexer.cpp \
+    $$TOPLEVELDIR/src/pgnparser.cpp \
+    $$TOPLEVELDIR/src/pgnsplitter.cpp \
+    $$TOPLEVELDIR/src/position.cpp \
+    $$TOPLEVELDIR/src/square.cpp \
+    $$TOPLEVELDIR/src/zobrist.cpp \
 
 HEADERS += \
     testobject.h \
+    testfen.h \
+    testpgnparser.h \
+    testpgnsplitter.h \
+    $$TOPLEVELDIR/src/pgnlexer.h \
+    $$TOPLEVELDIR/src/pgnparser.h \